@@ -17,6 +17,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include "cs_timer.h"
 #include "cs_workerpool.h"
 #include "cs_events.h"
+#include "cs_evgroup.h"
 #include "cs_network_runtime.h"
 #include "cs_psk.h"
 
@@ -90,6 +91,7 @@ typedef struct cs_engine_s{
 
   /* Event manager, network runtime */
   cs_event_manager_t *evm; //set by the user
+  cs_evm_group_t *evg; //set by the user, evm is then its first member
   cs_network_runtime_t *net_rt; //set by the user
 
   /* Workerpool, timer, network runtime, etc */
@@ -103,6 +105,8 @@ typedef struct cs_engine_s{
   /* Flags */ 
   sim_type_t st; //init
   int running; //internal flag
+  int skip_idle_ticks; //init
+  long int steps; //the steps of the last simulation, i.e. the ticks the clock went through
 
   /* Mutex */
   pthread_mutex_t *lock;
@@ -142,6 +146,12 @@ void cs_set_termination_function(cs_engine_t *engine, int (*func) (cs_data_ptr i
 */
 void cs_set_event_manager(cs_engine_t *engine, cs_event_manager_t *evm);
 
+/**
+* Set a group of event managers, in place of a single one.
+* @see cs_evm_group_init
+*/
+void cs_set_event_group(cs_engine_t *engine, cs_evm_group_t *group);
+
 /**
 * Set the network runtime.
 */
@@ -152,6 +162,14 @@ void cs_set_network_runtime(cs_engine_t *engine, cs_network_runtime_t *cs_net_rt
 */
 void cs_set_sim_type(cs_engine_t *engine, sim_type_t st);
 
+/**
+* Enable or disable (default) the skipping of idle ticks. In an event driven 
+* simulation the clock goes straight to the time of the nearest events, 
+* or of the next after-step activity, when there is nothing to do before.
+* The engine and the controllers then step only on those ticks.
+*/
+void cs_set_skip_idle_ticks(cs_engine_t *engine, int enable);
+
 /*
 * Starts a simulation.
 */
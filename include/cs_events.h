@@ -15,19 +15,50 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include "complex_sim.h"
 #include "cs_timer.h"
 #include "cs_workerpool.h"
+#include "cs_evstore.h"
 #include "rb.h"
 #include <pthread.h>
 
 #define CS_EVM_TIMER(evm) ((evm)->timer)
-#define CS_NEW_EVENT(n) (cs_event_t *) malloc(n*sizeof(cs_event_t))
+#define CS_NEW_EVENT(n) cs_new_events(n)
 #define CS_EVENT_SET_TYPE(ev, type) ((ev)->etype = type)
 #define CS_EVENT_GET_TYPE(ev) ((ev)->etype)
-#define CS_EV_IS_TYPE(ev,type) (strcmp(type, (ev)->etype) == 0 ? 1 : 0)
+#define CS_EV_IS_TYPE(ev,type) ((ev)->etype == (type) || strcmp(type, (ev)->etype) == 0 ? 1 : 0)
+#define CS_EVENT_GET_TYPE_ID(ev) ((ev)->etid)
+#define CS_EV_IS_TYPE_ID(ev,id) ((ev)->etid == (id))
 #define CS_EV_SET_DATA(ev, data) {(ev)->ev_data = data}
 #define CS_EV_GET_DATA(ev) ((ev)->ev_data)
+#define CS_EV_SET_TARGET(ev, t) ((ev)->target = (t))
+#define CS_EV_GET_TARGET(ev) cs_ev_target(ev)
+#define CS_EV_INLINE(ev) ((void *) (ev)->ev_inline)
+#define CS_EV_DATA_IS_INLINE(ev) ((ev)->ev_data == CS_EV_INLINE(ev))
+
+/** 
+* Size of the payload stored inside the event; with the default
+* an event takes a cache line. The library and its users must be
+* compiled with the same value.
+*/
+#ifndef CS_EV_INLINE_SIZE
+#define CS_EV_INLINE_SIZE 32
+#endif
+
+/** flags of the event: ev_data has been allocated by the event manager */
+#define CS_EV_DATA_OWNED 0x1
+/** flags of the event: scheduled through a handle (see cs_evm_schedule_event_handle) */
+#define CS_EV_HANDLED 0x2
+/** flags of the event: its periodic schedules have been stopped (see cs_evm_stop_periodic) */
+#define CS_EV_PERIODIC_STOP 0x4
 
 typedef const char* cs_event_type_t;
 
+/** Maximum number of event types of an event manager */
+#define CS_EVM_MAX_TYPES 256
+/** Number of slots of the cache mapping type names to type ids */
+#define CS_EVM_TYPE_CACHE 512
+/** Bounds of the priorities of the event types (see cs_evm_set_type_priority) */
+#define CS_EVM_MIN_PRIORITY (-128)
+#define CS_EVM_MAX_PRIORITY 127
+
 /**
 * The code returned by an event handler.
 */
@@ -44,34 +75,250 @@ typedef enum cs_eh_status_e{
 typedef struct cs_event_s{
     cs_event_type_t etype;
     cs_data_ptr ev_data;
+    /** the id of the type, set by the event manager when the event is scheduled */
+    int etid;
+    /** number of pending schedules of the event (used to recycle pooled events) */
+    int pending;
+    short int flags;
+    /** generation of the event, increased when a schedule by handle is made, raised or cancelled: odd while it is live */
+    unsigned int gen;
+    /** the entity affected by the event, < 0 if none (see cs_evm_conf_t.lookahead and cs_ev_init) */
+    long int target;
+    /** the time of the live schedule by handle, < 0 if none */
+    cs_clockv sched_at;
+    /** payload area, ev_data points here when the data fits */
+    char ev_inline[CS_EV_INLINE_SIZE] __attribute__((aligned(16)));
 }cs_event_t;
 
-typedef struct cs_event_list_item_s{
-  cs_event_t *ev;
-  struct cs_event_list_item_s *enext;
-}cs_event_list_item_t;
-
 /**
 * A list of events. It is intented
 * to collect a set of events to be scheduled
-* in the same tick of clock.
+* in the same tick of clock. The events are kept 
+* in a growable array, in order of scheduling.
 */
 typedef struct cs_event_list_s{
-    cs_event_list_item_t *head, *tail;
-    cs_clockv scheduled_at;
+    cs_event_t **evs;
     int count;
-    cs_event_list_item_t **guards;
+    int size; //the capacity of evs
+    cs_clockv scheduled_at;
+    /* next list in the same bucket (calendar queue store) */
+    struct cs_event_list_s *cnext;
 }cs_event_list_t;
 
+/* the partition (out of nparts) of an event, by target */
+#define _CS_EVM_PART(ev, nparts) ((ev)->target<0 ? 0 : (int) ((unsigned long) (ev)->target % (nparts)))
+
+/** Initial capacity of the array of an event list */
+#define CS_EV_LIST_MIN_SIZE 16
+
+/** Maximum number of events claimed at once by a worker */
+#define CS_EVM_CLAIM_CHUNK 64
+
 /*
 * The event handler table.
 */
 typedef struct rb_table cs_event_handler_table_t;
 
+/**
+* A shard of the set of pending events, i.e. a store of event 
+* lists with its own lock. Each thread schedules into its own 
+* shard, thus concurrent schedules do not contend on a single lock.
+* The lists of the same tick are merged when the tick is popped.
+*/
+typedef struct cs_event_shard_s{
+  pthread_mutex_t *lock;
+  cs_evstore_t *store;
+  long int count; //events in the store: written under the lock, read without it
+  char pad[CS_CACHE_LINE-sizeof(pthread_mutex_t *)-sizeof(cs_evstore_t *)-sizeof(long int)];
+}cs_event_shard_t;
+
+/** Number of scheduling times that a schedule buffer can hold */
+#define CS_EVM_WBUF_RUNS 8
+
+/**
+* Buffer of the events scheduled by the handlers run by a worker 
+* for the next ticks. It is owned by the worker, thus no lock is
+* needed; the events are merged into the shards when the tick is 
+* closed by the controller.
+*/
+typedef struct cs_evm_wbuf_s{
+  /* one list of events for each scheduling time */
+  cs_event_list_t runs[CS_EVM_WBUF_RUNS];
+  int nruns;
+  int last; //the last run appended to
+  /* the events scheduled for the current tick, raised by the next delta cycle */
+  cs_event_list_t delta;
+  char pad[CS_CACHE_LINE];
+}cs_evm_wbuf_t;
+
+/** Maximum number of delta cycles of a tick, further events are deferred to the next tick */
+#define CS_EVM_MAX_DELTA_CYCLES 1024
+
+/** Number of events of the first chunk of the event pool; each new chunk doubles */
+#define CS_EVM_POOL_CHUNK 256
+/** Maximum number of events of a chunk of the event pool */
+#define CS_EVM_POOL_MAX_CHUNK 65536
+/** Number of events moved at once between the shared pool and the pools of the workers */
+#define CS_EVM_POOL_BATCH 64
+
+/**
+* A free list of pooled events, linked through their ev_data field.
+* @see cs_evm_alloc_event
+*/
+typedef struct cs_evm_pool_s{
+  cs_event_t *free;
+  int nfree;
+  char pad[CS_CACHE_LINE];
+}cs_evm_pool_t;
+
 /*
-* The event lists' tree.
+* The chunks of memory holding the pooled events, sorted by address.
+* A new index replaces the old one when a chunk is added, so that it
+* can be searched without locks; the old ones are kept until the 
+* event manager is destroyed.
 */
-typedef struct rb_table cs_event_tree_t;
+typedef struct cs_evm_chunk_index_s{
+  struct cs_evm_chunk_index_s *retired;
+  int n;
+  cs_event_t **lo, **hi; //bounds of the chunks, allocated along with the index
+}cs_evm_chunk_index_t;
+
+/** Number of slots of the timing wheel of the periodic events */
+#define CS_EVM_WHEEL_SLOTS 256
+
+/*
+* A periodic schedule of an event, in the slot (next % CS_EVM_WHEEL_SLOTS) 
+* of the timing wheel.
+*/
+typedef struct cs_evm_periodic_s{
+  cs_event_t *ev;
+  cs_clockv next;
+  cs_clockv period;
+  long int count; //the occurrences left, < 0 if endless
+  struct cs_evm_periodic_s *wnext;
+}cs_evm_periodic_t;
+
+/*
+* The timing wheel of the periodic events: an occurrence is raised by 
+* moving the schedule to another slot, without inserting the event in 
+* the shards.
+*/
+typedef struct cs_evm_wheel_s{
+  cs_evm_periodic_t *slots[CS_EVM_WHEEL_SLOTS];
+  long int n; //the periodic schedules, read without the lock
+  cs_clockv now; //the last tick raised, < 0 if none
+  pthread_mutex_t *lock;
+}cs_evm_wheel_t;
+
+/**
+* Configuration of the event manager.
+* @see cs_evm_default_conf
+*/
+typedef struct cs_evm_conf_s{
+  /** number of shards of the pending events (<=0: one per worker) */
+  int nshards;
+  /** data structure storing the pending events (default: CS_EVSTORE_RBTREE) */
+  cs_evstore_type store;
+  /** 
+  * minimum delay between an event and the events it schedules (default: 1). 
+  * With a lookahead L > 1 all the events in [t, t+L) are handled concurrently, 
+  * those of the same target by the same worker in time order, and the events
+  * without target all by a single worker in time order. 
+  */
+  cs_clockv lookahead;
+  /**
+  * route the events of a tick with a target to the mailbox of a fixed task,
+  * by target (default: 0). The events of an entity are then handled by the
+  * same task, one at a time, with its schedule buffer and its pool; the
+  * events without target are shared by all the tasks.
+  */
+  short int affinity;
+  /**
+  * the events scheduled farther than spill_horizon from the clock are 
+  * written to a file, and paged in as the clock approaches them (default: 0, 
+  * disabled). Only the pooled events with an inline payload (or none) are 
+  * spilled; they are rebuilt as new pooled events.
+  */
+  cs_clockv spill_horizon;
+  /** the spill file, NULL (default) for an anonymous temporary file */
+  const char *spill_path;
+  /**
+  * sort the events of a tick by priority of their type (see 
+  * cs_evm_set_type_priority), type and target before handling them 
+  * (default: 0), so that the events of a type are handled in runs.
+  * Not applied to the windows of a lookahead > 1.
+  */
+  short int sort_ticks;
+}cs_evm_conf_t;
+
+/* the event manager, defined below */
+struct cs_event_manager_s;
+
+/**
+* The definition of the event handler.
+*/
+typedef cs_eh_status (*cs_event_handler_t) (cs_event_t * ev, struct cs_event_manager_s *evm);
+
+/*
+* A hook taking the events scheduled by the handlers, in place of the 
+* event manager (see _cs_evm_run_handler). 
+* It returns a value < 0 if the event cannot be scheduled.
+*/
+typedef int (*cs_evm_send_hook_t) (cs_event_t *ev, cs_clockv at, void *arg, struct cs_event_manager_s *evm);
+
+/**
+* The definition of the batch event handler: it handles n events of the same type.
+*/
+typedef cs_eh_status (*cs_event_batch_handler_t) (cs_event_t **evs, size_t n, struct cs_event_manager_s *evm);
+
+/*
+* A slot of the cache of the type ids, keyed by the 
+* address of the type name.
+*/
+typedef struct cs_evm_type_slot_s{
+  cs_event_type_t etype;
+  int etid;
+}cs_evm_type_slot_t;
+
+/*
+* A handler subscribed to an event type, along with the handler installed
+* by cs_evm_install_handler (see cs_evm_subscribe).
+*/
+typedef struct cs_evm_subscriber_s{
+  cs_event_handler_t handler;
+  int priority;
+}cs_evm_subscriber_t;
+
+/*
+* The subscribers of a type, sorted by priority: those before split run
+* before the handler of the type. A chain is never modified once 
+* published; all the chains are kept until the event manager is destroyed.
+*/
+typedef struct cs_evm_chain_s{
+  struct cs_evm_chain_s *retired;
+  int n;
+  int split;
+  cs_evm_subscriber_t *subs; //allocated along with the chain
+}cs_evm_chain_t;
+
+/*
+* A snapshot of the handler table, never modified once published: an 
+* install copies the current snapshot, changes the copy and publishes 
+* it. The old snapshots are kept until the event manager is destroyed,
+* thus the handlers are looked up without locks.
+*/
+typedef struct cs_evm_htab_s{
+  struct cs_evm_htab_s *retired;
+  int ntypes;
+  int nbatch_handlers;
+  cs_event_handler_t handlers[CS_EVM_MAX_TYPES];
+  cs_event_batch_handler_t batch_handlers[CS_EVM_MAX_TYPES];
+  cs_evm_chain_t *chains[CS_EVM_MAX_TYPES];
+  /* the priorities of the types in the sorted ticks */
+  signed char priorities[CS_EVM_MAX_TYPES];
+  /* the types sorted by name, to resolve the names not in the type cache */
+  cs_evm_type_slot_t by_name[CS_EVM_MAX_TYPES];
+}cs_evm_htab_t;
 
 /**
 * The event manager object.
@@ -79,9 +326,51 @@ typedef struct rb_table cs_event_tree_t;
 typedef struct cs_event_manager_s{
   cs_event_handler_table_t *eh_tree;
   pthread_mutex_t *eh_tree_lock;
-  pthread_mutex_t *ev_tree_lock;
 
-  cs_event_tree_t *ev_tree;
+  /* the interned event types, indexed by id, and the snapshot of their handlers */
+  cs_event_type_t type_names[CS_EVM_MAX_TYPES];
+  cs_evm_htab_t *htab;
+  cs_evm_chain_t *chains; //all the chains of subscribers, linked by retired
+  int ntypes;
+  cs_evm_type_slot_t type_cache[CS_EVM_TYPE_CACHE];
+
+  /* the pending events */
+  cs_event_shard_t *shards;
+  int nshards;
+  /* the schedule buffers of the workers */
+  cs_evm_wbuf_t *wbufs;
+  int nwbufs;
+  /* the pooled events: a pool for each worker (as many as wbufs), plus a shared one */
+  cs_evm_pool_t *pools;
+  cs_evm_pool_t shared_pool;
+  pthread_mutex_t *pool_lock;
+  cs_evm_chunk_index_t *chunks;
+  /* scratch array of the controller, to group the events of a tick by type */
+  cs_event_list_t sort_buf;
+  short int sort_ticks;
+  /* the lookahead, and the scratch arrays for the events of a window */
+  cs_clockv lookahead;
+  cs_event_list_t win;
+  cs_clockv *win_at;
+  int *win_parts;
+  /* the mailboxes of the tasks: the bounds of the events of each task in a tick */
+  short int affinity;
+  int *boxes;
+  /* the periodic events */
+  cs_evm_wheel_t wheel;
+  /* the far-future events written to a file, NULL if disabled (see cs_spill.h) */
+  struct cs_spill_s *spill;
+  /* the trace of the handled events, NULL if disabled (see cs_trace.h) */
+  struct cs_trace_s *trace;
+  /* the counters of the event types, NULL if never enabled (see cs_evstats.h) */
+  struct cs_evstats_s *evstats;
+  /* the state of the optimistic mode, NULL if disabled (see cs_timewarp.h) */
+  struct cs_timewarp_s *tw;
+  /* the group of event managers this one is a member of, NULL if none (see cs_evgroup.h), 
+     and the outboxes of the workers: one for each task and member of the group */
+  struct cs_evm_group_s *group;
+  int member;
+  cs_evm_wbuf_t *outboxes;
   cs_timer_t *timer;
 
   cs_workerpool_t *wp;
@@ -103,23 +392,24 @@ typedef struct cs_event_manager_s{
   int nguards; //== number of workers for event management
 } cs_event_manager_t;
 
-/**
-* The definition of the event handler.
-*/
-typedef cs_eh_status (*cs_event_handler_t) (cs_event_t * ev, cs_event_manager_t *evm);
-
-
 /*
 * An element of the table of the event handler.
 */
 typedef struct cs_event_handler_entry{
     cs_event_handler_t handler;
     cs_event_type_t etype;
+    int etid;
 }cs_event_handler_entry_t;
 
 typedef struct event_worker_data_s{
 //  cs_event_t *ev;
-  int guard_index, num_events;
+  int index; //the index of the task, i.e. of its schedule buffer
+  int *cursor; //the next event of the list to be claimed, shared by the tasks
+  int chunk; //the number of events claimed at once
+  /* window mode: the times of the events, and the bounds of the partitions */
+  cs_clockv *at;
+  int *parts, nparts; //in tick mode (affinity), the mailboxes of the tasks
+  cs_clockv now;
   cs_event_list_t *ev_list;
   cs_event_manager_t *evm;
 }event_worker_data_t;
@@ -134,6 +424,18 @@ void cs_destroy_event_manager(cs_event_manager_t * evm);
 * Initialize an event manager. 
 */
 int cs_init_event_manager(cs_event_manager_t *evm, int nworkers, cs_timer_t *timer, sim_type_t type);
+
+/**
+* Initialize an event manager with the specified configuration.
+* @param conf the configuration, NULL for the default one.
+* @see cs_evm_default_conf
+*/
+int cs_init_event_manager_conf(cs_event_manager_t *evm, int nworkers, cs_timer_t *timer, sim_type_t type, const cs_evm_conf_t *conf);
+
+/**
+* Fill conf with the default configuration of the event manager.
+*/
+void cs_evm_default_conf(cs_evm_conf_t *conf);
 /**
 * Schedule an event to be raised at clock time. 
 * @param ev the event to be raised
@@ -142,6 +444,84 @@ int cs_init_event_manager(cs_event_manager_t *evm, int nworkers, cs_timer_t *tim
 */
 int cs_evm_schedule_event(cs_event_t *ev, cs_clockv time, cs_event_manager_t *evm);
 
+/**
+* Schedule the event ev to be raised at start, start+period, ... for count 
+* times (endless if count < 0). The occurrences are raised by a timing 
+* wheel, without scheduling the event again; they are counted as a 
+* single pending event by cs_evm_num_events.
+* @return a value < 0 in the case of error.
+*/
+int cs_evm_schedule_periodic(cs_event_t *ev, cs_clockv start, cs_clockv period, long int count, cs_event_manager_t *evm);
+
+/**
+* Stop the periodic schedules of the event ev: the occurrences not yet 
+* raised are dropped.
+*/
+void cs_evm_stop_periodic(cs_event_t *ev, cs_event_manager_t *evm);
+
+/**
+* A schedule of an event, to be cancelled or moved.
+*/
+typedef struct cs_ev_handle_s{
+  cs_event_t *ev;
+  cs_clockv at;
+  unsigned int gen;
+}cs_ev_handle_t;
+
+/**
+* Schedule a pooled event (see cs_evm_alloc_event) to be raised at 
+* clock time, filling the handle h. The event can have a single live 
+* schedule by handle at once, and once scheduled by handle it must be 
+* scheduled again only by handle (e.g. by its own handler).
+* @return a value < 0 in the case of error.
+*/
+int cs_evm_schedule_event_handle(cs_event_t *ev, cs_clockv time, cs_event_manager_t *evm, cs_ev_handle_t *h);
+
+/**
+* Cancel the schedule h. The entry of the event stays in the event set
+* as a tombstone until its time, when it is dropped without dispatching.
+* @return a value < 0 if the event has already been raised or cancelled.
+*/
+int cs_evm_cancel(cs_ev_handle_t *h, cs_event_manager_t *evm);
+
+/**
+* Move the schedule h to the clock time, updating h.
+* @return a value < 0 if the event has already been raised or cancelled.
+*/
+int cs_evm_reschedule(cs_ev_handle_t *h, cs_clockv time, cs_event_manager_t *evm);
+
+/**
+* Schedule the event ev to be raised at clock time once for each of 
+* the ntargets targets, without copying it: the handlers (and the 
+* subscribers) of its type are run for each target in turn, and get 
+* the target through cs_ev_target. The deliveries are run by a single
+* worker, in the order of targets, without the serialization of the
+* events of a target (see cs_evm_conf_t.affinity); in a group of event
+* managers they are run by the member ev is scheduled on.
+* Not available in the optimistic mode.
+* @return a value < 0 in the case of error.
+*/
+int cs_evm_schedule_broadcast(cs_event_t *ev, cs_clockv time, const long int *targets, int ntargets, cs_event_manager_t *evm);
+
+/**
+* The target of the event ev: the target of the current delivery when
+* ev is being delivered by a broadcast, ev->target otherwise.
+*/
+long int cs_ev_target(cs_event_t *ev);
+
+/**
+* Initialize an event allocated by the user (e.g. on the stack), 
+* rather than by CS_NEW_EVENT or the pools of the event manager: no 
+* type, data, flags or pending schedules, and no target.
+*/
+void cs_ev_init(cs_event_t *ev);
+
+/**
+* Allocate n events, not pooled, each initialized as by cs_ev_init.
+* @return the events, NULL in the case of memory error.
+*/
+cs_event_t *cs_new_events(int n);
+
 /*
 * Get the handler associated to the event key ekey.
 * @param etype the type of event to raise
@@ -149,6 +529,110 @@ int cs_evm_schedule_event(cs_event_t *ev, cs_clockv time, cs_event_manager_t *ev
 */
 cs_event_handler_t cs_evm_get_handler(cs_event_type_t etype, cs_event_manager_t *evm);
 
+/**
+* Register an event type, giving it a (small) integer id. 
+* Registering again the same type returns the same id.
+* Types are registered also when an handler is installed, 
+* or when the first event of the type is scheduled.
+* 
+* @param etype the event type.
+* @param evm the event manager.
+* @return the id of the type, a value < 0 in the case of error.
+*/
+int cs_evm_register_type(cs_event_type_t etype, cs_event_manager_t *evm);
+
+/**
+* Get the name of the event type with the id etid.
+* @return the name of the type, NULL if not registered.
+*/
+cs_event_type_t cs_evm_type_name(int etid, cs_event_manager_t *evm);
+
+/**
+* Get a new event from the pools of the event manager. 
+* A pooled event is given back to the pool as soon as its handler 
+* returns, unless the handler schedules it again; thus
+* it must not be used after the handler has returned.
+* The ev_data is not released.
+*
+* @param etype the type of the event.
+* @param data the data of the event.
+* @param evm the event manager.
+* @return the event, NULL in the case of memory error.
+*/
+cs_event_t *cs_evm_alloc_event(cs_event_type_t etype, cs_data_ptr data, cs_event_manager_t *evm);
+
+/**
+* Get a new event from the pools of the event manager, 
+* copying size bytes of data as its payload. Small payloads 
+* (up to CS_EV_INLINE_SIZE bytes) are stored inside the event,
+* larger ones are allocated apart; in both cases ev_data points 
+* to the payload, which is released along with the event.
+*
+* @param etype the type of the event.
+* @param data the payload to copy, NULL for a zeroed payload.
+* @param size the size of the payload.
+* @param evm the event manager.
+* @return the event, NULL in the case of memory error.
+* @see cs_evm_alloc_event
+*/
+cs_event_t *cs_evm_alloc_event_data(cs_event_type_t etype, const void *data, size_t size, cs_event_manager_t *evm);
+
+/**
+* Give back to the pool an event that has been allocated 
+* by cs_evm_alloc_event and never scheduled.
+*/
+void cs_evm_free_event(cs_event_t *ev, cs_event_manager_t *evm);
+
+/**
+* Install a batch handler for the events of type etype. 
+* When at least a batch handler is installed, the events of each
+* tick are grouped by type before being dispatched, and the events 
+* of a type with a batch handler are passed to it in runs;
+* the batch handler takes the place of the handler of the same type.
+*
+* @param etype the event type.
+* @param handler the batch handler, NULL to remove it.
+* @param evm the event manager.
+* @return a value < 0 in the case of error, 0 otherwise.
+*/
+int cs_evm_install_batch_handler(cs_event_type_t etype, cs_event_batch_handler_t handler, cs_event_manager_t *evm);
+
+/**
+* Set the priority of the events of type etype in the sorted ticks 
+* (see cs_evm_conf_t.sort_ticks): the events of a tick are handled in
+* increasing order of priority, then by type and target.
+* @param priority a value in [CS_EVM_MIN_PRIORITY, CS_EVM_MAX_PRIORITY], 0 by default.
+* @return a value < 0 in the case of error, 0 otherwise.
+*/
+int cs_evm_set_type_priority(cs_event_type_t etype, int priority, cs_event_manager_t *evm);
+
+/**
+* Subscribe a further handler to the events of type etype. The 
+* subscribers are run in increasing order of priority: those with 
+* priority < 0 before the handler of the type (see cs_evm_install_handler),
+* the others after it, each one on every event of the type, batch 
+* handlers included. The status of the dispatch is that of the handler
+* of the type; the events of a type with subscribers only are handled.
+* @param priority the order of the subscriber; the subscribers of the 
+* same priority run in order of subscription.
+* @return a value < 0 in the case of error, or if handler is already subscribed.
+*/
+int cs_evm_subscribe(cs_event_type_t etype, cs_event_handler_t handler, int priority, cs_event_manager_t *evm);
+
+/**
+* Remove a subscriber of the type etype.
+* @return a value < 0 if handler is not subscribed to etype.
+*/
+int cs_evm_unsubscribe(cs_event_type_t etype, cs_event_handler_t handler, cs_event_manager_t *evm);
+
+/**
+* Get the time of the event being handled, when called by an handler; 
+* the clock otherwise. With a lookahead > 1 the events of different times 
+* are handled together, thus the handlers should use this time instead
+* of the clock.
+*/
+cs_clockv cs_evm_now(cs_event_manager_t *evm);
+
 /**
 * Throw the specified event.
 * 
@@ -207,7 +691,8 @@ cs_clockv cs_evm_find_nearest_events(cs_event_manager_t * evm);
 cs_clockv cs_evm_find_farthest_events(cs_event_manager_t *evm);
 
 /**
-* The total number of scheduled events.
+* The total number of scheduled events. The counters are kept 
+* by the shards, thus no lock is taken.
 * @return the number of events in the event tree;
 */
 int cs_evm_num_events(cs_event_manager_t *evm);
@@ -252,4 +737,18 @@ int cs_ev_is_type(cs_event_t *ev, cs_event_type_t *type);
 */
 void wait_event_completion(cs_event_manager_t *evm, cs_clockv clock);
 
+/*
+* Internals shared with the execution modes of the controller.
+*/
+int _cs_evm_gather_window(cs_event_manager_t *evm, cs_clockv end);
+cs_eh_status _cs_evm_run_handler(cs_event_manager_t *evm, cs_event_t *ev, cs_clockv at, int index, cs_evm_send_hook_t send, void *send_arg);
+int _cs_evm_store_event(cs_event_manager_t *evm, cs_event_t *ev, cs_clockv at);
+void _cs_evm_event_done(cs_event_manager_t *evm, cs_event_t *ev);
+short int _cs_evm_is_pooled(cs_event_manager_t *evm, cs_event_t *ev);
+int _cs_evm_resolve_type(cs_event_manager_t *evm, cs_event_type_t etype, short int create);
+int _cs_evm_task_index(cs_event_manager_t *evm);
+extern const char _cs_evm_broadcast_type[];
+int _cs_evm_wbuf_append(cs_evm_wbuf_t *buf, cs_event_t *ev, cs_clockv at);
+void _cs_evm_merge_wbuf(cs_event_manager_t *evm, cs_evm_wbuf_t *buf, cs_event_shard_t *shard);
+
 #endif
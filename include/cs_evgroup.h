@@ -0,0 +1,122 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef _CS_EVGROUP_H_
+
+#define _CS_EVGROUP_H_
+
+#include "complex_sim.h"
+#include "cs_events.h"
+
+/**
+* The member of a group owning a target, in [0, nmembers).
+*/
+typedef int (*cs_evm_group_route_t) (long int target, int nmembers);
+
+/**
+* A group of event managers sharing a timer, each one with its own 
+* shards, pools and workers, e.g. one for each NUMA node. The events 
+* with a target are handled by the member owning the target; those 
+* without target by the member they are scheduled on. The events 
+* scheduled by a handler for a target of another member are buffered 
+* in an outbox of the worker, and flushed into the shards of that 
+* member at the end of the tick, with a lock for each outbox.
+* @see cs_evm_group_init
+*/
+typedef struct cs_evm_group_s{
+  cs_event_manager_t *members;
+  int nmembers;
+  cs_evm_group_route_t route;
+}cs_evm_group_t;
+
+/**
+* Init a group of nmembers event managers, each one with nworkers 
+* workers and the configuration conf (NULL for the default one).
+* Each controller syncs on the timer as a separate agent: the timer
+* must expect nmembers agents more than a single event manager (see 
+* cs_set_nsync); the engine does it with cs_set_event_group. 
+* The members handle one tick at a time: the lookahead must be 1, and
+* the optimistic mode is not available. A handler can schedule an 
+* event for a target of another member from the next tick on.
+* @return a value < 0 in the case of error.
+*/
+int cs_evm_group_init(cs_evm_group_t *group, int nmembers, int nworkers, cs_timer_t *timer, sim_type_t type, const cs_evm_conf_t *conf);
+
+/**
+* Destroy the event managers of the group.
+*/
+void cs_evm_group_destroy(cs_evm_group_t *group);
+
+/**
+* Set the routing of the targets to the members (default: target % nmembers).
+* To be called before scheduling any event.
+*/
+void cs_evm_group_set_route(cs_evm_group_t *group, cs_evm_group_route_t route);
+
+/**
+* Get the member owning a target, the first one for target < 0.
+*/
+cs_event_manager_t *cs_evm_group_member(cs_evm_group_t *group, long int target);
+
+/**
+* Install the handler of an event type on all the members.
+* @return a value < 0 in the case of error.
+*/
+int cs_evm_group_install_handler(cs_evm_group_t *group, cs_event_type_t etype, cs_event_handler_t handler);
+
+/**
+* Bind the workers (and the controller) of a member to a set of cpus,
+* e.g. those of a NUMA node. To be called before starting the group.
+* The pools of the member grow from its workers, thus from that node.
+* @see cs_wp_set_cpus
+*/
+int cs_evm_group_bind(cs_evm_group_t *group, int member, const int *cpus, int ncpus);
+
+/**
+* Start the controllers of all the members.
+*/
+int cs_evm_group_start(cs_evm_group_t *group, cs_clockv start_raising);
+
+/**
+* Stop the controllers of all the members.
+*/
+void cs_evm_group_stop(cs_evm_group_t *group);
+
+/**
+* The number of events of all the members.
+*/
+int cs_evm_group_num_events(cs_evm_group_t *group);
+
+/**
+* The time of the nearest events of all the members, < 0 if none.
+*/
+cs_clockv cs_evm_group_find_nearest_events(cs_evm_group_t *group);
+
+/**
+* Wait for all the members to complete the tick clock.
+*/
+void cs_evm_group_wait_completion(cs_evm_group_t *group, cs_clockv clock);
+
+/*
+* Schedule ev, of a target owned by the member dest, from the member evm.
+* The pending count of ev is already taken.
+* @return a value < 0 in the case of error.
+*/
+int _cs_evgroup_send(cs_event_manager_t *evm, cs_event_manager_t *dest, cs_event_t *ev, cs_clockv at);
+
+/*
+* Flush the outboxes of evm into the other members.
+* @return the time of the nearest event flushed, < 0 if none.
+*/
+cs_clockv _cs_evgroup_flush(cs_event_manager_t *evm);
+
+#endif
@@ -0,0 +1,100 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef _CS_EVSTATS_H_
+
+#define _CS_EVSTATS_H_
+
+#include <pthread.h>
+#include "complex_sim.h"
+#include "cs_stats.h"
+#include "cs_events.h"
+
+/**
+* Counters of an event type.
+* @see cs_evm_enable_type_stats
+*/
+typedef struct cs_evm_type_stats_s{
+  /** events handled */
+  unsigned long thrown;
+  /** schedules of events */
+  unsigned long scheduled;
+  /** time (ns) spent in the handlers */
+  unsigned long long handler_ns;
+  /** time (ns) of a handler call, one sample per call (per batch for the batch handlers) */
+  cs_log_hist_t latency;
+}cs_evm_type_stats_t;
+
+/*
+* The counters of the event types: a row of CS_EVM_MAX_TYPES counters 
+* for each task of the controller, written without locks, plus a row
+* for the other threads, guarded by lock. The rows are merged by the 
+* snapshots.
+*/
+typedef struct cs_evstats_s{
+  cs_evm_type_stats_t *rows;
+  int nrows;
+  short int on;
+  pthread_mutex_t lock;
+  /* the totals at the last dump, for the figures of a tick */
+  unsigned long last_thrown[CS_EVM_MAX_TYPES];
+  unsigned long last_scheduled[CS_EVM_MAX_TYPES];
+  unsigned long long last_type_ns[CS_EVM_MAX_TYPES];
+  unsigned long long *last_row_ns;
+}cs_evstats_t;
+
+/**
+* Enable (or disable) the counters of the event types. Once enabled, 
+* every tick is dumped to the log category "cs.events.stats", at the 
+* DEBUG priority: the counters of the tick for each type, and the 
+* handler time of each task of the controller.
+* @return a value < 0 in the case of error.
+*/
+int cs_evm_enable_type_stats(cs_event_manager_t *evm, short int enable);
+
+/**
+* Take a snapshot of the counters of an event type, merging those of
+* all the tasks. The snapshot is exact between two ticks.
+* @return a value < 0 whenever the counters are not enabled or the 
+* type is unknown, 0 otherwise.
+*/
+int cs_evm_type_stats(cs_event_manager_t *evm, cs_event_type_t etype, cs_evm_type_stats_t *snapshot);
+
+/**
+* Reset the counters of the event types. To be called 
+* while the controller is not running.
+*/
+void cs_evm_reset_type_stats(cs_event_manager_t *evm);
+
+/*
+* Count n events of the type etid handled in ns nanoseconds by a 
+* single handler call, in the row of the task index (< 0: the other 
+* threads).
+*/
+void _cs_evstats_handled(cs_event_manager_t *evm, int index, int etid, int n, unsigned long long ns);
+
+/*
+* Count a schedule of an event of the type etid.
+*/
+void _cs_evstats_scheduled(cs_event_manager_t *evm, int index, int etid);
+
+/*
+* Dump the counters of the tick at, if the log category is enabled.
+*/
+void _cs_evstats_dump(cs_event_manager_t *evm, cs_clockv at);
+
+/*
+* Release the counters.
+*/
+void _cs_evstats_destroy(cs_event_manager_t *evm);
+
+#endif
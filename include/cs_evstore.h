@@ -0,0 +1,107 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef CS_EVSTORE_H__
+#define CS_EVSTORE_H__
+
+#include "cs_timer.h"
+
+struct cs_event_list_s;
+
+/**
+* The data structure used to store the lists of 
+* events, indexed by their scheduling time.
+*/
+typedef enum cs_evstore_type_e{
+  /** a red-black tree of event lists */
+  CS_EVSTORE_RBTREE,
+  /** a calendar queue, with amortized O(1) insert and pop-min */
+  CS_EVSTORE_CALENDAR
+}cs_evstore_type;
+
+/**
+* The operations of an event store.
+*/
+typedef struct cs_evstore_ops_s{
+  struct cs_event_list_s *(*find) (void *impl, cs_clockv at);
+  int (*insert) (void *impl, struct cs_event_list_s *list);
+  struct cs_event_list_s *(*remove) (void *impl, cs_clockv at);
+  struct cs_event_list_s *(*first) (void *impl);
+  struct cs_event_list_s *(*last) (void *impl);
+  int (*count) (void *impl);
+  void (*walk) (void *impl, void (*func) (struct cs_event_list_s *list, void *param), void *param);
+  void (*destroy) (void *impl, void (*func) (void *item, void *param));
+}cs_evstore_ops_t;
+
+/**
+* An event store: a set of event lists, with at most one 
+* list for each scheduling time. It is not thread-safe.
+*/
+typedef struct cs_evstore_s{
+  cs_evstore_type type;
+  const cs_evstore_ops_t *ops;
+  void *impl;
+}cs_evstore_t;
+
+/**
+* Create an event store. 
+* @param type the data structure of the store.
+* @return the new store, NULL in the case of error.
+*/
+cs_evstore_t *cs_evstore_create(cs_evstore_type type);
+
+/**
+* Destroy the store.
+* @param func a function called on each remaining list, may be NULL.
+*/
+void cs_evstore_destroy(cs_evstore_t *st, void (*func) (void *item, void *param));
+
+/**
+* Find the list of events scheduled at the time at.
+* @return the list, NULL if no list has been found. 
+*/
+struct cs_event_list_s *cs_evstore_find(cs_evstore_t *st, cs_clockv at);
+
+/**
+* Insert a new list. A list with the same scheduling time 
+* must not be in the store.
+* @return a value < 0 whenever something was wrong, 0 otherwise. 
+*/
+int cs_evstore_insert(cs_evstore_t *st, struct cs_event_list_s *list);
+
+/**
+* Remove and return the list of events scheduled at the time at.
+* @return the list, NULL if no list has been found. 
+*/
+struct cs_event_list_s *cs_evstore_remove(cs_evstore_t *st, cs_clockv at);
+
+/**
+* The list with the minimum scheduling time, NULL if the store is empty.
+*/
+struct cs_event_list_s *cs_evstore_first(cs_evstore_t *st);
+
+/**
+* The list with the maximum scheduling time, NULL if the store is empty.
+*/
+struct cs_event_list_s *cs_evstore_last(cs_evstore_t *st);
+
+/**
+* The number of lists in the store.
+*/
+int cs_evstore_count(cs_evstore_t *st);
+
+/**
+* Call func on each list of the store (in no particular order).
+*/
+void cs_evstore_walk(cs_evstore_t *st, void (*func) (struct cs_event_list_s *list, void *param), void *param);
+
+#endif
@@ -24,6 +24,9 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #define MIN(a,b) (a<b ? a : b)
 #define MAX(a,b) (a>b ? a : b)
 
+/** Size of a cache line, used to pad data shared between threads */
+#define CS_CACHE_LINE 64
+
 typedef enum sim_type_s{
   EVENT_DRIVEN,
   ACTIVITY_SCAN
@@ -13,6 +13,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #define CS_QUEUE_H__
 
 #include "cs_psk.h"
+#include "cs_stats.h"
 
 #define _CS_QUEUE_LOCK(q) (pthread_mutex_lock(((cs_queue *) q)->qmutex))
 #define _CS_QUEUE_UNLOCK(q) (pthread_mutex_unlock(((cs_queue *) q)->qmutex))
@@ -36,8 +37,30 @@ typedef struct cs_qelem_s {
     */
     void *data;
     struct cs_qelem_s *next, *prev;
+    /**
+    * Enqueue time (ns), set only when the statistics are enabled.
+    */
+    unsigned long long enq_ns;
 }cs_qelem;
 
+/**
+* Counters of a queue, collected only 
+* when enabled through cs_queue_enable_stats().
+*/
+typedef struct cs_queue_stats_s{
+    unsigned long enqueues;
+    unsigned long dequeues;
+    /** time (ns) spent by producers waiting for a free slot */
+    unsigned long long producer_blocked_ns;
+    /** time (ns) spent by consumers waiting for an element */
+    unsigned long long consumer_blocked_ns;
+    /** current and maximum number of elements in the queue */
+    int depth;
+    int max_depth;
+    /** time (ns) spent by the elements into the queue */
+    cs_log_hist_t residence;
+}cs_queue_stats_t;
+
 /**
 * The queue object. 
 */
@@ -63,6 +86,11 @@ typedef struct queue_s {
     * used to release data within the elements of the queue.
     */
     void (*rel_func) (void *);
+
+    /**
+    * The counters of the queue, NULL when disabled.
+    */
+    cs_queue_stats_t *stats;
 } cs_queue;
 
 /**
@@ -107,6 +135,30 @@ int cs_queue_init(cs_queue *q, const char *name, void (*rel_func) (void *), unsi
 */
 int cs_queue_close(cs_queue * q);
 
+/**
+* Enable (or disable) the collection of the counters of the queue. 
+* Enabling the counters resets them.
+* @param q the pointer to the queue
+* @param enable a value != 0 to enable the counters, 0 to disable them
+* @return a value < 0 whenever something was wrong, 0 otherwise. 
+*/
+int cs_queue_enable_stats(cs_queue *q, short int enable);
+
+/**
+* Take a snapshot of the counters of the queue. It holds the lock of the 
+* queue just for a copy of the counters, so it can be called at each tick.
+* @param q the pointer to the queue
+* @param snapshot where the counters are copied
+* @return a value < 0 whenever the counters are not enabled, 0 otherwise. 
+*/
+int cs_queue_get_stats(cs_queue *q, cs_queue_stats_t *snapshot);
+
+/**
+* Reset the counters of the queue, but the current depth.
+* @param q the pointer to the queue
+*/
+void cs_queue_reset_stats(cs_queue *q);
+
 /**
 * Release the memory allocated for the queue and all its 
 * elements. @warning: all the remaining elements will be discarded, 
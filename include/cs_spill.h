@@ -0,0 +1,102 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef _CS_SPILL_H_
+
+#define _CS_SPILL_H_
+
+#include <stdio.h>
+#include "complex_sim.h"
+#include "cs_events.h"
+
+/** Number of records of a block of the spill file */
+#define CS_SPILL_BLOCK 64
+
+/*
+* An event written to the spill file: the type by id, and the inline payload.
+*/
+typedef struct cs_spill_rec_s{
+  cs_clockv at;
+  long int target;
+  int etid;
+  short int has_data;
+  char data[CS_EV_INLINE_SIZE];
+}cs_spill_rec_t;
+
+/*
+* The events of the times [idx*horizon, (idx+1)*horizon): the full blocks 
+* are in the file, the last one is in memory.
+*/
+typedef struct cs_spill_bucket_s{
+  long int idx;
+  cs_clockv min_at, max_at;
+  long int n;
+  long int *blocks; //the offsets of the blocks in the file
+  int nblocks, blocks_size;
+  cs_spill_rec_t *tail;
+  int ntail;
+}cs_spill_bucket_t;
+
+/*
+* The far-future tier of the pending events.
+*/
+typedef struct cs_spill_s{
+  cs_clockv horizon;
+  cs_clockv base; //the events scheduled from here on are spilled
+  FILE *file;
+  long int end; //the end of the file
+  struct rb_table *buckets;
+  long int n; //the spilled events, read without the lock
+  long int written; //the events written since the start
+  pthread_mutex_t *lock;
+}cs_spill_t;
+
+/*
+* Enable the spill of the event manager (called at the initialization).
+* @param path the spill file, NULL for an anonymous temporary file.
+* @return a value < 0 in the case of error.
+*/
+int _cs_spill_init(cs_event_manager_t *evm, cs_clockv horizon, const char *path);
+
+/*
+* Spill the event ev scheduled at the time at, if it is far enough and 
+* its payload is inline: the event is then released.
+* @return 0 if spilled, 1 if not, a value < 0 in the case of error.
+*/
+int _cs_spill_event(cs_event_manager_t *evm, cs_event_t *ev, cs_clockv at);
+
+/*
+* Page in the buckets before cur_time+horizon, and move the base.
+*/
+void _cs_spill_page_in(cs_event_manager_t *evm, cs_clockv cur_time);
+
+/*
+* The time of the nearest spilled event, < 0 if none.
+*/
+cs_clockv _cs_spill_nearest(cs_event_manager_t *evm);
+
+/*
+* The time of the farthest spilled event, < 0 if none.
+*/
+cs_clockv _cs_spill_farthest(cs_event_manager_t *evm);
+
+/*
+* Release the spill (the file is closed, and the events lost).
+*/
+void _cs_spill_destroy(cs_event_manager_t *evm);
+
+/**
+* The number of events written to the spill file so far.
+*/
+long int cs_evm_spilled_events(cs_event_manager_t *evm);
+
+#endif
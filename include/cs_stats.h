@@ -0,0 +1,72 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef CS_STATS_H__
+#define CS_STATS_H__
+
+/**
+* Number of buckets of a log-bucketed histogram. 
+* Bucket i collects the samples v such that 2^(i-1) <= v < 2^i 
+* (bucket 0 collects the zeroes), the last bucket collects 
+* everything else.
+*/
+#define CS_LOG_HIST_BUCKETS 40
+
+/**
+* A log-bucketed (powers of two) histogram. 
+*/
+typedef struct cs_log_hist_s{
+  unsigned long count[CS_LOG_HIST_BUCKETS];
+  unsigned long samples;
+  unsigned long long sum;
+  unsigned long long max;
+}cs_log_hist_t;
+
+/**
+* Read a monotonic clock.
+* @return the current time, in nanoseconds. 
+*/
+unsigned long long cs_stats_now_ns();
+
+/**
+* Reset the histogram.
+* @param h the histogram
+*/
+void cs_log_hist_reset(cs_log_hist_t *h);
+
+/**
+* Add a sample to the histogram. 
+* @param h the histogram
+* @param v the value of the sample
+*/
+void cs_log_hist_add(cs_log_hist_t *h, unsigned long long v);
+
+/**
+* Add the samples of the histogram src into dst.
+*/
+void cs_log_hist_merge(cs_log_hist_t *dst, const cs_log_hist_t *src);
+
+/**
+* Upper bound (excluded) of the values collected by a bucket.
+* @param bucket the index of the bucket
+*/
+unsigned long long cs_log_hist_bucket_bound(int bucket);
+
+/**
+* Estimate a percentile of the samples, as the upper bound of the 
+* bucket containing it.
+* @param h the histogram
+* @param p the percentile, in [0,100]
+*/
+unsigned long long cs_log_hist_percentile(const cs_log_hist_t *h, double p);
+
+#endif
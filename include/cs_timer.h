@@ -23,6 +23,7 @@ typedef struct cs_timer_s {
     int n_sync;
     int sync;
     cs_clockv clock;
+    cs_clockv next; //the earliest time proposed in the current round (<0: none)
     pthread_mutex_t *mutex;
     const char *id;
     pthread_cond_t *cond;
@@ -58,6 +59,19 @@ void cs_destroy_timer(cs_timer_t *timer);
 */
 int cs_time_sync(cs_timer_t *timer); 
 
+/**
+* Wait for the next time of clock, proposing the time at which 
+* the caller has something to do. When all the agents have synchronized, 
+* the clock goes to the earliest time proposed, thus skipping 
+* the ticks in which nobody has anything to do. 
+* Proposing a time not greater than the clock means the next tick, 
+* as cs_time_sync does.
+* @param timer the timer.
+* @param at the time proposed.
+* @return a value < 0 if the timer has been stopped, 0 otherwise.
+*/
+int cs_time_sync_to(cs_timer_t *timer, cs_clockv at);
+
 void cs_time_stop(cs_timer_t *timer);
 
 void cs_set_nsync(cs_timer_t *timer, int nsync);
@@ -0,0 +1,173 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef _CS_TIMEWARP_H_
+
+#define _CS_TIMEWARP_H_
+
+#include "complex_sim.h"
+#include "cs_events.h"
+
+/**
+* Save the state of the entity target, before one of its events is handled.
+* @return the saved state.
+*/
+typedef void *(*cs_tw_save_state_t) (long int target, void *arg);
+/**
+* Restore the state of the entity target, previously saved.
+*/
+typedef void (*cs_tw_restore_state_t) (long int target, void *state, void *arg);
+/**
+* Release a saved state, not needed anymore.
+*/
+typedef void (*cs_tw_discard_state_t) (long int target, void *state, void *arg);
+
+/* the states of a message of the optimistic mode */
+typedef enum cs_tw_msg_state_e{
+  CS_TW_QUEUED,    //in the queue of its partition
+  CS_TW_PROCESSED, //handled, in the log of its partition
+  CS_TW_OUT,       //to be delivered to another partition
+  CS_TW_FUTURE,    //beyond the window
+  CS_TW_CANCELLED  //annihilated by a rollback
+}cs_tw_msg_state;
+
+/*
+* A schedule of an event within a window of the optimistic mode.
+*/
+typedef struct cs_tw_msg_s{
+  cs_event_t *ev;
+  cs_clockv at;
+  long int seq; //orders the messages of the same time
+  int part; //the partition of the event
+  int rec; //the index in the log of the partition, when processed
+  cs_tw_msg_state state;
+  struct cs_tw_msg_s *next_send; //next message sent by the same event
+  struct cs_tw_msg_s *next_alloc; //next message allocated by the same partition
+}cs_tw_msg_t;
+
+/*
+* An event handled speculatively: the state saved before 
+* handling it, and the messages it has sent.
+*/
+typedef struct cs_tw_rec_s{
+  cs_tw_msg_t *msg;
+  void *state;
+  cs_tw_msg_t *sends;
+}cs_tw_rec_t;
+
+/*
+* A partition of the entities, handled by a single worker at once.
+*/
+typedef struct cs_tw_part_s{
+  cs_tw_msg_t **heap; //the queue of the messages, by time
+  int nheap, heap_size;
+  cs_tw_rec_t *log; //the handled messages, in time order
+  int nlog, log_size;
+  cs_tw_msg_t **out; //the messages for other partitions
+  int nout, out_size;
+  cs_tw_msg_t *allocated;
+  char pad[CS_CACHE_LINE];
+}cs_tw_part_t;
+
+/**
+* Counters of the optimistic mode.
+*/
+typedef struct cs_tw_stats_s{
+  /** events committed, i.e. handled before the GVT */
+  long int committed;
+  /** events handled and then rolled back */
+  long int rolled_back;
+  /** number of rollbacks */
+  long int rollbacks;
+  /** messages annihilated by the rollbacks */
+  long int cancelled;
+  /** number of phases, i.e. of barriers between the workers */
+  long int phases;
+}cs_tw_stats_t;
+
+/*
+* The argument of a task of the workerpool, during a phase.
+*/
+typedef struct cs_tw_task_s{
+  cs_event_manager_t *evm;
+  int index;
+}cs_tw_task_t;
+
+/*
+* The state of the optimistic mode of an event manager.
+*/
+typedef struct cs_timewarp_s{
+  cs_clockv window;
+  cs_tw_save_state_t save;
+  cs_tw_restore_state_t restore;
+  cs_tw_discard_state_t discard;
+  void *arg;
+
+  cs_tw_part_t *parts;
+  int nparts;
+  cs_tw_task_t *tasks;
+  int ntasks;
+  int cursor; //the next partition to be claimed in a phase
+  cs_clockv end; //the end of the current window, i.e. the next GVT
+  long int seq;
+  cs_tw_stats_t stats;
+}cs_timewarp_t;
+
+/**
+* Enable the optimistic (Time Warp) mode of the event manager.
+* The events in [t, t+window) are handled speculatively: each worker 
+* handles the events of some entities (by target) in time order, without
+* waiting for the others. When an event arrives for an entity which has
+* already handled later events, the entity is rolled back: its state 
+* is restored through the callbacks, and the events scheduled by the
+* rolled back handlers are annihilated. At the end of the window all
+* the events before t+window are committed (the GVT), and the saved
+* states released.
+* 
+* The handlers must not schedule events in the past (with respect to
+* cs_evm_now), must change only the state of the target of their event,
+* and must not modify their event; any other effect is not rolled back.
+* To be called before starting the controller.
+*
+* @param evm the event manager.
+* @param window the size of the window.
+* @param save the callback saving the state of an entity, NULL if entities have no state.
+* @param restore the callback restoring the state of an entity.
+* @param discard the callback releasing a saved state, may be NULL.
+* @param arg the argument of the callbacks.
+* @return a value < 0 in the case of error, 0 otherwise.
+*/
+int cs_evm_enable_timewarp(
+  cs_event_manager_t *evm,
+  cs_clockv window,
+  cs_tw_save_state_t save,
+  cs_tw_restore_state_t restore,
+  cs_tw_discard_state_t discard,
+  void *arg);
+
+/**
+* Get the counters of the optimistic mode.
+* @return a value < 0 if the optimistic mode is not enabled.
+*/
+int cs_evm_timewarp_stats(cs_event_manager_t *evm, cs_tw_stats_t *stats);
+
+/*
+* Handle the window starting at cur_time (called by the controller).
+*/
+int _cs_tw_run_window(cs_event_manager_t *evm, cs_clockv cur_time);
+
+/*
+* Release the memory of the optimistic mode.
+*/
+void _cs_tw_destroy(cs_event_manager_t *evm);
+
+#endif
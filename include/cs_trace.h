@@ -0,0 +1,123 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef _CS_TRACE_H_
+
+#define _CS_TRACE_H_
+
+#include <stdio.h>
+#include <pthread.h>
+#include "complex_sim.h"
+#include "cs_events.h"
+
+/** Size of a page of the trace writer */
+#define CS_TRACE_PAGE (1<<16)
+/** Number of full pages waiting for the writer, for each buffer, before the tasks wait */
+#define CS_TRACE_QUEUE 2
+/** Magic number at the start of a trace */
+#define CS_TRACE_MAGIC 0x52544343
+
+/*
+* A record of the trace, followed by size bytes: the payload of the 
+* event, or the name of the type for the type records (etid < 0, the 
+* id of the type is -etid-1).
+*/
+typedef struct cs_trace_rec_s{
+  cs_clockv at;
+  long int target;
+  int etid;
+  int size;
+}cs_trace_rec_t;
+
+/*
+* The records of a task: a page, handed over to the writer when full.
+* Only its task appends to it, without locks. The pages of the buffers
+* reach the file in any order, thus each buffer records the name of a
+* type before its first event.
+*/
+typedef struct cs_trace_buf_s{
+  char *page;
+  size_t fill;
+  long int nevents;
+  int busy; //set while the task appends (see cs_evm_trace_stop)
+  short int typed[CS_EVM_MAX_TYPES];
+  char pad[CS_CACHE_LINE];
+}cs_trace_buf_t;
+
+/*
+* A page handed over to the writer.
+*/
+typedef struct cs_trace_page_s{
+  char *data;
+  size_t fill;
+}cs_trace_page_t;
+
+/*
+* The trace of the handled events: the tasks fill their own pages, and
+* take the lock only to hand them over to the background writer.
+*/
+typedef struct cs_trace_s{
+  FILE *file;
+  /* a buffer for each task, plus a shared one under the lock */
+  cs_trace_buf_t *bufs;
+  int nbufs;
+  /* the pages handed over, written in order, and the written ones, to be reused */
+  cs_trace_page_t *queue;
+  int head;
+  int nqueued;
+  int qsize;
+  char **spare;
+  int nspare;
+  short int stop; //no more records
+  short int closing; //the writer exits once the queue is empty
+  pthread_t writer;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+}cs_trace_t;
+
+/**
+* Record every event handled by the event manager in a binary trace:
+* time, type, target and inline payload (the payloads not inline are
+* not recorded).
+* @param path the trace file.
+* @return a value < 0 in the case of error.
+*/
+int cs_evm_trace_start(cs_event_manager_t *evm, const char *path);
+
+/**
+* Stop the trace, waiting for the writer to complete it. The events
+* handled from now on are not recorded.
+* @return the number of events recorded, a value < 0 in the case of error.
+*/
+long int cs_evm_trace_stop(cs_event_manager_t *evm);
+
+/**
+* Replay a trace against the handlers of evm, in the order of recording,
+* from the calling thread. Each event is rebuilt with its time (see 
+* cs_evm_now), target and payload; the events scheduled by the handlers
+* are dropped; the events of a type with a batch handler are passed to
+* it one at a time. Meant as a benchmark of the handlers alone.
+* @return the number of events replayed, a value < 0 in the case of error.
+*/
+long int cs_evm_trace_replay(cs_event_manager_t *evm, const char *path);
+
+/*
+* Record the n events evs, handled at the time at.
+*/
+void _cs_trace_events(cs_event_manager_t *evm, cs_event_t **evs, int n, cs_clockv at);
+
+/*
+* Stop the trace, and release it.
+*/
+void _cs_trace_destroy(cs_event_manager_t *evm);
+
+#endif
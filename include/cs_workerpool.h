@@ -135,6 +135,9 @@ typedef struct workerpool_s {
     sem_t *workerpool_semaphore;
     _cs_wp_worker_data *workers_data;
     _cs_wp_tsk_table *tsk_res_tb;
+    /* the cpus the threads are bound to, none if ncpus==0 */
+    int *cpus;
+    int ncpus;
 }cs_workerpool_t;
 
 
@@ -161,6 +164,13 @@ void cs_wp_destroy(cs_workerpool_t * wp);
  * Start the workerpool
  */
 int cs_wp_start(cs_workerpool_t * tp);
+/**
+ * Bind the threads of the workerpool to a set of cpus, e.g. those of 
+ * a NUMA node. To be called before starting the workerpool.
+ * @param cpus the ids of the cpus, ncpus==0 to unbind.
+ * @return a value < 0 in the case of error.
+ */
+int cs_wp_set_cpus(cs_workerpool_t * wp, const int *cpus, int ncpus);
 /**
  * Shutdown the workerpool.
  */
@@ -180,6 +190,17 @@ cs_wp_tsk_id cs_wp_tsk_enqueue(
  * @param the worker pool
  */
 int cs_wp_tsk_queue_size(cs_workerpool_t * wp);
+/**
+ * Enable (or disable) the counters of the task queue.
+ * @see cs_queue_enable_stats
+ */
+int cs_wp_tsk_queue_enable_stats(cs_workerpool_t * wp, short int enable);
+/**
+ * Take a snapshot of the counters of the task queue.
+ * @return a value < 0 whenever the counters are not enabled, 0 otherwise.
+ * @see cs_queue_get_stats
+ */
+int cs_wp_tsk_queue_stats(cs_workerpool_t * wp, cs_queue_stats_t *snapshot);
 /**
 * Wait for a completion of a task. 
 */
@@ -24,26 +24,24 @@ const cs_event_type_t et[7] = {"T0", "T1", "T2", "T3", "T4", "T5", "T6"};
 cs_eh_status ev_handler(cs_event_t *ev, cs_event_manager_t *evm){
   //the sequence of events is T0->T2
   //or T1->T3,T4
-  cs_event_t *eva;
+  cs_event_t *eva[2];
   int n = 0; int i;
   log4c_category_log(log4c_category_get("cs.sample"), LOG4C_PRIORITY_TRACE, "sample1.handler, T=%li, ev=%s",\
     cs_get_clock(CS_EVM_TIMER(evm)), ev->etype);
   if(CS_EV_IS_TYPE(ev, et[0])){ //T0 --> T2
     n = 1;
-    eva = CS_NEW_EVENT(n);
-    CS_EVENT_SET_TYPE(eva,et[2]);
+    eva[0] = cs_evm_alloc_event(et[2], NULL, evm);
   }
   else if(CS_EV_IS_TYPE(ev, et[1])){ //T1 --> T3,T4
     n = 2;
-    eva = CS_NEW_EVENT(n);
-    CS_EVENT_SET_TYPE(eva,et[3]);  //T3
-    CS_EVENT_SET_TYPE(&(eva[1]),et[4]);  //T4
+    eva[0] = cs_evm_alloc_event(et[3], NULL, evm);  //T3
+    eva[1] = cs_evm_alloc_event(et[4], NULL, evm);  //T4
   }
 
   for(i=0; i<n; i++){
-    log4c_category_log(log4c_category_get("cs.sample"), LOG4C_PRIORITY_INFO, "Scheduling event %s @%li", eva[i].etype,cs_get_clock(CS_EVM_TIMER(evm))+1);
-    if(cs_evm_schedule_event(&(eva[i]), cs_get_clock(CS_EVM_TIMER(evm))+1 /* next time */, evm)!=0){
-      log4c_category_log(log4c_category_get("cs.sample"), LOG4C_PRIORITY_FATAL, "Error scheduling event %s", eva[0].etype);
+    log4c_category_log(log4c_category_get("cs.sample"), LOG4C_PRIORITY_INFO, "Scheduling event %s @%li", eva[i]->etype,cs_get_clock(CS_EVM_TIMER(evm))+1);
+    if(cs_evm_schedule_event(eva[i], cs_get_clock(CS_EVM_TIMER(evm))+1 /* next time */, evm)!=0){
+      log4c_category_log(log4c_category_get("cs.sample"), LOG4C_PRIORITY_FATAL, "Error scheduling event %s", eva[i]->etype);
       return CS_EH_ERROR;
     }
   }
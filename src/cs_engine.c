@@ -166,6 +166,13 @@ void cs_set_event_manager(cs_engine_t *engine, cs_event_manager_t *evm){
   engine->evm = evm;
 }
 
+void cs_set_event_group(cs_engine_t *engine, cs_evm_group_t *group){
+  assert(group!=NULL && group->nmembers>0);
+  cs_set_event_manager(engine, &group->members[0]);
+  if(engine->evm==&group->members[0])
+    engine->evg = group;
+}
+
 void cs_set_network_runtime(cs_engine_t *engine, cs_network_runtime_t *net_rt){
   if(_check_already_running(engine)){
     log4c_category_log(log4c_category_get("cs.engine"), LOG4C_PRIORITY_WARN, "Trying to (re)set\
@@ -236,12 +243,46 @@ int cs_event_driven_simulation(cs_engine_t *engine){
   return (engine->st == EVENT_DRIVEN);
 }
 
+/*
+* The number of pending events, of the event manager or of the group.
+*/
+int _cs_engine_num_events(cs_engine_t *engine){
+  return (engine->evg!=NULL ? cs_evm_group_num_events(engine->evg) : cs_evm_num_events(engine->evm));
+}
+
 void _cs_stop_actors(cs_engine_t *engine){
-  if(engine->evm!=NULL)
+  if(engine->evg!=NULL)
+    cs_evm_group_stop(engine->evg);
+  else if(engine->evm!=NULL)
     cs_evm_stop_controller(engine->evm);
   cs_time_stop(engine->timer);
 }
 
+/*
+* The time proposed by the engine to the timer: in an event driven 
+* simulation, the earliest between the nearest events and the next
+* execution of the after-step activities; the next tick otherwise.
+*/
+cs_clockv _cs_engine_next_time(cs_engine_t *engine){
+  cs_user_activity_t *act;
+  cs_clockv next, due;
+  cs_clockv cur_time = cs_get_clock(engine->timer);
+
+  if(!engine->skip_idle_ticks || !cs_event_driven_simulation(engine) || engine->evm==NULL)
+    return cur_time+1;
+
+  next = (engine->evg!=NULL ? cs_evm_group_find_nearest_events(engine->evg) : cs_evm_find_nearest_events(engine->evm));
+  if(next<=cur_time)
+    return cur_time+1;
+
+  for(act=engine->alist->activities; act!=NULL; act=act->next)
+    if(act->type==AFTER_STEP && act->n_tasks>0){
+      due = (act->last_execution_time<0 ? cur_time+1 : act->last_execution_time+act->nsteps);
+      next = MIN(next, MAX(due, cur_time+1));
+    }
+  return next;
+}
+
 void _engine_main_loop(cs_engine_t *engine){
 
   /* ENGINE					    GENERIC ACTOR
@@ -270,7 +311,7 @@ void _engine_main_loop(cs_engine_t *engine){
   /* Start the event controller, if any */
   if(events && !cs_evm_running(engine->evm)){
     log4c_category_log(log4c_category_get("cs.engine"), LOG4C_PRIORITY_INFO, "Starting event controller (t=%li)", cs_get_clock(engine->timer));
-    if(cs_evm_start_controller(engine->evm, 1)<0)
+    if((engine->evg!=NULL ? cs_evm_group_start(engine->evg, 1) : cs_evm_start_controller(engine->evm, 1))<0)
       log4c_category_log(log4c_category_get("cs.engine"), LOG4C_PRIORITY_ERROR, "while starting event controller (t=%li)", cs_get_clock(engine->timer));
   }
 
@@ -279,6 +320,7 @@ void _engine_main_loop(cs_engine_t *engine){
     cs_wp_start(engine->wp);
 
   //cur_time == 0
+  engine->steps = 0;
   while(!stop){
 
     //schedule AFTER_STEP activities
@@ -288,18 +330,19 @@ void _engine_main_loop(cs_engine_t *engine){
     if(_check_termination(engine))
       stop = 1;
 
-    else if(events && !cs_evm_more_events(engine->evm) && cs_event_driven_simulation(engine))
+    else if(events && _cs_engine_num_events(engine)==0 && cs_event_driven_simulation(engine))
       stop = 1;
 
     //sync into the timer (i.e. sync with the other actors)
     log4c_category_log(log4c_category_get("cs.engine"), LOG4C_PRIORITY_INFO, "(t=%li) - Syncing..", cur_time);
-    cs_time_sync(engine->timer);
+    cs_time_sync_to(engine->timer, (stop ? cur_time+1 : _cs_engine_next_time(engine)));
     cur_time = cs_get_clock(engine->timer);
 
     if(stop){
       _cs_stop_actors(engine);
       break;
     }
+    engine->steps++;
 
     switch(engine->st){
       case ACTIVITY_SCAN:
@@ -310,7 +353,9 @@ void _engine_main_loop(cs_engine_t *engine){
     }
 
     //wait for the completion of events
-    if(events)
+    if(engine->evg!=NULL)
+      cs_evm_group_wait_completion(engine->evg, cur_time);
+    else if(events)
       wait_event_completion(engine->evm, cur_time);
   }
 
@@ -331,7 +376,9 @@ void _destroy_activity_list(cs_user_activity_list_t *alist){
 }
 
 void cs_engine_fini(cs_engine_t *engine){
-  if(ENG_EVM(engine)!=NULL)
+  if(engine->evg!=NULL)
+    cs_evm_group_destroy(engine->evg);
+  else if(ENG_EVM(engine)!=NULL)
     cs_destroy_event_manager(engine->evm);
 
   cs_wp_shutdown(engine->wp);
@@ -368,6 +415,8 @@ void cs_sim_start(cs_engine_t *engine){
   assert(c1 || c2 || c3);
 
   nactors+=c2+c3; //The engine itself drives the workepool for the activities
+  if(engine->evg!=NULL)
+    nactors+=engine->evg->nmembers-1; //a controller for each member
 
   log4c_category_log(log4c_category_get("cs.engine"), LOG4C_PRIORITY_DEBUG, "Setting nactors as %li", nactors);
   fflush(stderr); fflush(stdout);
@@ -404,7 +453,10 @@ int cs_init_engine(cs_engine_t *engine, int wp_nworkers){
 
   engine->net_rt = NULL;
   engine->evm = NULL;
+  engine->evg = NULL;
   engine->running = 0;
+  engine->skip_idle_ticks = 0;
+  engine->steps = 0;
 
   pthread_mutex_unlock(engine->lock);
 
@@ -415,6 +467,12 @@ void cs_set_sim_type(cs_engine_t *engine, sim_type_t st){
   engine->st = st;
 }
 
+void cs_set_skip_idle_ticks(cs_engine_t *engine, int enable){
+  if(_check_already_running(engine))
+    return;
+  engine->skip_idle_ticks = enable;
+}
+
 const char *activity_to_string(activity_type_e type){
   switch(type){
     case USER:
@@ -17,16 +17,62 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 #include "complex_sim.h"
 #include "cs_events.h"
+#include "cs_timewarp.h"
+#include "cs_spill.h"
+#include "cs_trace.h"
+#include "cs_evstats.h"
+#include "cs_evgroup.h"
 #include "cs_concurrence.h"
 
-void lock_ev_tree(cs_event_manager_t *evm)
+/*
+* Index of the shard used by the current thread to schedule events, 
+* assigned round-robin the first time the thread schedules an event.
+*/
+static __thread int _cs_evm_shard_hint = -1;
+static int _cs_evm_shard_counter = 0;
+
+/*
+* The context of the event handlers run by a worker of an event manager.
+*/
+typedef struct _cs_evm_worker_ctx_s{
+  cs_event_manager_t *evm;
+  int index; //the index of the schedule buffer
+  cs_clockv now; //the last tick being processed
+  cs_clockv ev_now; //the time of the event being handled
+  cs_evm_send_hook_t send; //if set, it takes the events scheduled by the handlers
+  void *send_arg;
+}_cs_evm_worker_ctx;
+
+static __thread _cs_evm_worker_ctx *_cs_evm_ctx = NULL;
+
+/* the event being delivered by a broadcast, and the target of the delivery */
+static __thread cs_event_t *_cs_evm_bcast_ev = NULL;
+static __thread long int _cs_evm_bcast_target = -1;
+
+/* the type of the events carrying a broadcast */
+const char _cs_evm_broadcast_type[] = "CS_BROADCAST";
+
+/* defined along with the periodic events */
+void _cs_evm_destroy_wheel(cs_event_manager_t *evm);
+
+void lock_shard(cs_event_shard_t *shard)
+{
+    pthread_mutex_lock(shard->lock);
+}
+
+void unlock_shard(cs_event_shard_t *shard)
 {
-    pthread_mutex_lock(evm->ev_tree_lock);
+    pthread_mutex_unlock(shard->lock);
 }
 
-void unlock_ev_tree(cs_event_manager_t * evm)
+/*
+* Get the shard in which the current thread schedules its events.
+*/
+cs_event_shard_t *_cs_evm_my_shard(cs_event_manager_t *evm)
 {
-    pthread_mutex_unlock(evm->ev_tree_lock);
+    if(_cs_evm_shard_hint<0)
+      _cs_evm_shard_hint = __sync_fetch_and_add(&_cs_evm_shard_counter, 1);
+    return &evm->shards[_cs_evm_shard_hint % evm->nshards];
 }
 
 void lock_eh_tree(cs_event_manager_t * evm)
@@ -48,45 +94,545 @@ int cmp_handler_func(const void *t1, const void *t2, void *param){
   return strcmp((const char *) eh1->etype, (const char *) eh2->etype);
 }
 
-int cmp_event_list(const void *t1, const void *t2, void *param){
-  const cs_event_list_t* el1 = t1;
-  const cs_event_list_t* el2 = t2;
-  if(t1==NULL || t2==NULL)
+/*
+* The first slot of the type cache to probe for the name etype.
+*/
+int _cs_evm_type_hash(cs_event_type_t etype){
+  unsigned long h = ((unsigned long) etype) >> 3;
+  return (int) ((h * 2654435761UL) & (CS_EVM_TYPE_CACHE-1));
+}
+
+/*
+* Lock-free lookup of the id of a type, through the address of its name.
+* @return the id of the type, a value < 0 if the address is not in the cache.
+*/
+int _cs_evm_cached_type_id(cs_event_manager_t *evm, cs_event_type_t etype){
+  int i, h = _cs_evm_type_hash(etype);
+  cs_evm_type_slot_t *slot;
+  cs_event_type_t key;
+  for(i=0; i<CS_EVM_TYPE_CACHE; i++){
+    slot = &evm->type_cache[(h+i) & (CS_EVM_TYPE_CACHE-1)];
+    key = __atomic_load_n(&slot->etype, __ATOMIC_ACQUIRE);
+    if(key==etype)
+      return slot->etid;
+    if(key==NULL)
+      return -1;
+  }
+  return -1;
+}
+
+/*
+* Add the address of a type name to the type cache. 
+* To be called with the handler table locked; when the cache is full
+* the type is simply not cached.
+*/
+void _cs_evm_cache_type_id(cs_event_manager_t *evm, cs_event_type_t etype, int etid){
+  int i, h = _cs_evm_type_hash(etype);
+  cs_evm_type_slot_t *slot;
+  for(i=0; i<CS_EVM_TYPE_CACHE; i++){
+    slot = &evm->type_cache[(h+i) & (CS_EVM_TYPE_CACHE-1)];
+    if(slot->etype==etype)
+      return;
+    if(slot->etype==NULL){
+      slot->etid = etid;
+      //publish the key only after the id
+      __atomic_store_n(&slot->etype, etype, __ATOMIC_RELEASE);
+      return;
+    }
+  }
+}
+
+/*
+* A copy of the current snapshot of the handler table, to be changed
+* and published. To be called with the handler table locked.
+*/
+cs_evm_htab_t *_cs_evm_htab_copy(cs_event_manager_t *evm){
+  cs_evm_htab_t *ht;
+  if(!(ht = (cs_evm_htab_t *) malloc(sizeof(cs_evm_htab_t)))){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error copying the handler table");
+    return NULL;
+  }
+  memcpy(ht, evm->htab, sizeof(cs_evm_htab_t));
+  ht->retired = evm->htab;
+  return ht;
+}
+
+/*
+* Publish a new snapshot of the handler table, retiring the current one.
+*/
+void _cs_evm_htab_publish(cs_event_manager_t *evm, cs_evm_htab_t *ht){
+  __atomic_store_n(&evm->htab, ht, __ATOMIC_RELEASE);
+}
+
+/*
+* Lock-free lookup of the id of a type, by name, in a snapshot.
+* @return the id of the type, a value < 0 if not registered.
+*/
+int _cs_evm_htab_find(cs_evm_htab_t *ht, cs_event_type_t etype){
+  int lo = 0, hi = ht->ntypes-1, mid, c;
+  while(lo<=hi){
+    mid = (lo+hi)/2;
+    if((c = strcmp((const char *) etype, (const char *) ht->by_name[mid].etype))==0)
+      return ht->by_name[mid].etid;
+    else if(c<0)
+      hi = mid-1;
+    else
+      lo = mid+1;
+  }
+  return -1;
+}
+
+/*
+* Find the entry of the handler table for the type etype, 
+* creating it (and so registering the type) if create is set.
+* To be called with the handler table locked.
+*/
+cs_event_handler_entry_t *_cs_evm_type_entry(cs_event_manager_t *evm, cs_event_type_t etype, short int create){
+  cs_event_handler_entry_t search, *entry;
+  cs_evm_htab_t *ht;
+  int i;
+  search.etype = etype;
+  entry = (cs_event_handler_entry_t *) rb_find(evm->eh_tree, &search);
+  if(entry==NULL){
+    if(!create)
+      return NULL;
+    if(evm->ntypes>=CS_EVM_MAX_TYPES){
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Too many event types, cannot register type %s", etype);
+      return NULL;
+    }
+    if(!(ht = _cs_evm_htab_copy(evm)))
+      return NULL;
+    if(!(entry = (cs_event_handler_entry_t *) malloc(sizeof(cs_event_handler_entry_t)))){
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error registering event type %s", etype);
+      free(ht);
+      return NULL;
+    }
+    entry->handler = NULL;
+    entry->etype = etype;
+    entry->etid = evm->ntypes;
+    rb_insert(evm->eh_tree, entry);
+    evm->type_names[entry->etid] = etype;
+    __atomic_store_n(&evm->ntypes, evm->ntypes+1, __ATOMIC_RELEASE);
+
+    //keep the names of the snapshot sorted
+    for(i=ht->ntypes; i>0 && strcmp((const char *) etype, (const char *) ht->by_name[i-1].etype)<0; i--)
+      ht->by_name[i] = ht->by_name[i-1];
+    ht->by_name[i].etype = etype;
+    ht->by_name[i].etid = entry->etid;
+    ht->ntypes++;
+    _cs_evm_htab_publish(evm, ht);
+  }
+  //the same name may live at more than one address
+  _cs_evm_cache_type_id(evm, etype, entry->etid);
+  return entry;
+}
+
+/*
+* Get the id of the type etype, registering it if create is set.
+*/
+int _cs_evm_resolve_type(cs_event_manager_t *evm, cs_event_type_t etype, short int create){
+  int etid;
+  cs_event_handler_entry_t *entry;
+  if(etype==NULL)
+    return -1;
+  if((etid = _cs_evm_cached_type_id(evm, etype))>=0)
+    return etid;
+  //a name at a new address: the lock is only needed to cache it, or to register it
+  if((etid = _cs_evm_htab_find(__atomic_load_n(&evm->htab, __ATOMIC_ACQUIRE), etype))>=0){
+    if(pthread_mutex_trylock(evm->eh_tree_lock)==0){
+      _cs_evm_cache_type_id(evm, etype, etid);
+      unlock_eh_tree(evm);
+    }
+    return etid;
+  }
+  if(!create)
     return -1;
-  return (el1->scheduled_at > el2->scheduled_at ? 1 : (el1->scheduled_at < el2->scheduled_at ? -1 : 0));
+  lock_eh_tree(evm);
+  entry = _cs_evm_type_entry(evm, etype, create);
+  etid = (entry!=NULL ? entry->etid : -1);
+  unlock_eh_tree(evm);
+  return etid;
 }
 
-void destroy_event_list(void *item, void *param){
-  cs_event_list_t *list = item;
-  cs_event_list_item_t *elem, *next;
-  if(list == NULL || list->count == 0)
+int cs_evm_register_type(cs_event_type_t etype, cs_event_manager_t *evm){
+  if(etype==NULL || strlen((const char *) etype)==0){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_register_type(), parameter etype cannot be null or empty!");
+    return -1;
+  }
+  return _cs_evm_resolve_type(evm, etype, 1);
+}
+
+cs_event_type_t cs_evm_type_name(int etid, cs_event_manager_t *evm){
+  if(etid<0 || etid>=__atomic_load_n(&evm->ntypes, __ATOMIC_ACQUIRE))
+    return NULL;
+  return evm->type_names[etid];
+}
+
+/*
+* The index of the task of the controller running the current 
+* thread, < 0 if the thread is not running a handler of evm.
+*/
+int _cs_evm_task_index(cs_event_manager_t *evm){
+  if(_cs_evm_ctx!=NULL && _cs_evm_ctx->evm==evm)
+    return _cs_evm_ctx->index;
+  return -1;
+}
+
+/*
+* Whether the counters of the event types are enabled.
+*/
+short int _cs_evm_stats_on(cs_event_manager_t *evm){
+  cs_evstats_t *st = __atomic_load_n(&evm->evstats, __ATOMIC_ACQUIRE);
+  return (st!=NULL && __atomic_load_n(&st->on, __ATOMIC_ACQUIRE));
+}
+
+/*
+* Run the subscribers chain->subs[first..last) on ev.
+*/
+void _cs_evm_run_subscribers(cs_event_manager_t *evm, cs_evm_chain_t *chain, cs_event_t *ev, int first, int last){
+  int i;
+  for(i=first; i<last; i++)
+    chain->subs[i].handler(ev, evm);
+}
+
+/*
+* Run the handler of ev, and the subscribers of its type around it.
+*/
+cs_eh_status _cs_evm_run_chain(cs_event_manager_t *evm, cs_event_handler_t handler, cs_evm_chain_t *chain, cs_event_t *ev){
+  cs_eh_status ret = CS_EH_NORMAL;
+  if(chain==NULL)
+    return handler(ev, evm);
+  _cs_evm_run_subscribers(evm, chain, ev, 0, chain->split);
+  if(handler!=NULL)
+    ret = handler(ev, evm);
+  _cs_evm_run_subscribers(evm, chain, ev, chain->split, chain->n);
+  return ret;
+}
+
+/*
+* Run the handler of an event whose type id is already known.
+*/
+cs_eh_status _cs_evm_dispatch(cs_event_manager_t *evm, cs_event_t *ev){
+  cs_evm_htab_t *ht = __atomic_load_n(&evm->htab, __ATOMIC_ACQUIRE);
+  cs_event_handler_t handler = NULL;
+  cs_evm_chain_t *chain = NULL;
+  cs_eh_status ret;
+  unsigned long long t0;
+  if(ev->etid>=0 && ev->etid<CS_EVM_MAX_TYPES){
+    handler = ht->handlers[ev->etid];
+    chain = ht->chains[ev->etid];
+  }
+  if(handler==NULL && chain==NULL){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "no event handler for event type %s", ev->etype);
+    return CS_EH_NO_HANDLER;
+  }
+  //the carrier of a broadcast is not counted, its deliveries are
+  if(!_cs_evm_stats_on(evm) || ev->etype==_cs_evm_broadcast_type)
+    return _cs_evm_run_chain(evm, handler, chain, ev);
+  t0 = cs_stats_now_ns();
+  ret = _cs_evm_run_chain(evm, handler, chain, ev);
+  _cs_evstats_handled(evm, _cs_evm_task_index(evm), ev->etid, 1, cs_stats_now_ns()-t0);
+  return ret;
+}
+
+/*
+* Whether the event ev lies in a chunk of the pools of evm.
+*/
+short int _cs_evm_in_chunks(cs_event_manager_t *evm, cs_event_t *ev){
+  cs_evm_chunk_index_t *idx = __atomic_load_n(&evm->chunks, __ATOMIC_ACQUIRE);
+  unsigned long addr = (unsigned long) ev;
+  int lo = 0, hi, mid;
+  if(idx==NULL)
+    return 0;
+  hi = idx->n-1;
+  while(lo<=hi){
+    mid = (lo+hi)/2;
+    if(addr < (unsigned long) idx->lo[mid])
+      hi = mid-1;
+    else if(addr >= (unsigned long) idx->hi[mid])
+      lo = mid+1;
+    else
+      return 1;
+  }
+  return 0;
+}
+
+/*
+* The event manager whose pools hold ev: evm, or another member of 
+* its group. NULL if ev is not pooled.
+*/
+cs_event_manager_t *_cs_evm_pool_owner(cs_event_manager_t *evm, cs_event_t *ev){
+  int i;
+  if(_cs_evm_in_chunks(evm, ev))
+    return evm;
+  if(evm->group!=NULL)
+    for(i=0; i<evm->group->nmembers; i++)
+      if(&evm->group->members[i]!=evm && _cs_evm_in_chunks(&evm->group->members[i], ev))
+	return &evm->group->members[i];
+  return NULL;
+}
+
+/*
+* Whether the event ev is pooled, by evm or by another member of its group.
+*/
+short int _cs_evm_is_pooled(cs_event_manager_t *evm, cs_event_t *ev){
+  return (_cs_evm_pool_owner(evm, ev)!=NULL);
+}
+
+void _cs_evm_pool_put(cs_evm_pool_t *pool, cs_event_t *ev){
+  ev->ev_data = (cs_data_ptr) pool->free;
+  pool->free = ev;
+  pool->nfree++;
+}
+
+cs_event_t *_cs_evm_pool_get(cs_evm_pool_t *pool){
+  cs_event_t *ev = pool->free;
+  if(ev!=NULL){
+    pool->free = (cs_event_t *) ev->ev_data;
+    pool->nfree--;
+  }
+  return ev;
+}
+
+void _cs_evm_pool_move(cs_evm_pool_t *dst, cs_evm_pool_t *src, int n){
+  cs_event_t *ev;
+  while(n-->0 && (ev = _cs_evm_pool_get(src))!=NULL)
+    _cs_evm_pool_put(dst, ev);
+}
+
+/*
+* Add a new chunk of events to the shared pool. 
+* To be called with the pool lock held.
+*/
+int _cs_evm_pool_grow(cs_event_manager_t *evm){
+  cs_evm_chunk_index_t *old = evm->chunks, *idx;
+  int n = (old!=NULL ? old->n : 0), size, i, j;
+  cs_event_t *chunk;
+
+  size = (n<16 ? MIN(CS_EVM_POOL_CHUNK<<n, CS_EVM_POOL_MAX_CHUNK) : CS_EVM_POOL_MAX_CHUNK);
+  if(!(chunk = (cs_event_t *) calloc(size, sizeof(cs_event_t))))
+    return -1;
+  if(!(idx = (cs_evm_chunk_index_t *) malloc(sizeof(cs_evm_chunk_index_t)+2*(n+1)*sizeof(cs_event_t *)))){
+    free(chunk);
+    return -1;
+  }
+  idx->lo = (cs_event_t **) (idx+1);
+  idx->hi = idx->lo+n+1;
+  idx->n = n+1;
+  idx->retired = old;
+  for(i=0, j=0; i<n+1; i++){
+    if(j==i && (i==n || (unsigned long) chunk < (unsigned long) old->lo[i])){
+      idx->lo[i] = chunk;
+      idx->hi[i] = chunk+size;
+    }
+    else{
+      idx->lo[i] = old->lo[j];
+      idx->hi[i] = old->hi[j];
+      j++;
+    }
+  }
+  for(i=size-1; i>=0; i--)
+    _cs_evm_pool_put(&evm->shared_pool, &chunk[i]);
+  __atomic_store_n(&evm->chunks, idx, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/*
+* The pool of the current thread: the one of the worker 
+* when running a handler of evm, NULL otherwise.
+*/
+cs_evm_pool_t *_cs_evm_my_pool(cs_event_manager_t *evm){
+  if(_cs_evm_ctx!=NULL && _cs_evm_ctx->evm==evm)
+    return &evm->pools[_cs_evm_ctx->index];
+  return NULL;
+}
+
+cs_event_t *cs_evm_alloc_event(cs_event_type_t etype, cs_data_ptr data, cs_event_manager_t *evm){
+  cs_evm_pool_t *pool = _cs_evm_my_pool(evm);
+  cs_event_t *ev = NULL;
+
+  if(pool==NULL || (ev = _cs_evm_pool_get(pool))==NULL){
+    pthread_mutex_lock(evm->pool_lock);
+    if(evm->shared_pool.nfree==0 && _cs_evm_pool_grow(evm)<0){
+      pthread_mutex_unlock(evm->pool_lock);
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error while allocating pooled events");
+      return NULL;
+    }
+    if(pool!=NULL){
+      _cs_evm_pool_move(pool, &evm->shared_pool, CS_EVM_POOL_BATCH);
+      ev = _cs_evm_pool_get(pool);
+    }
+    else
+      ev = _cs_evm_pool_get(&evm->shared_pool);
+    pthread_mutex_unlock(evm->pool_lock);
+  }
+
+  ev->etype = etype;
+  ev->ev_data = data;
+  ev->etid = -1;
+  ev->pending = 0;
+  ev->flags = 0;
+  ev->target = -1;
+  ev->sched_at = -1;
+  return ev;
+}
+
+/*
+* Give a pooled event back to the pool of the current thread. 
+* The workers keep at most 2*CS_EVM_POOL_BATCH events, the rest
+* goes to the shared pool. The events of another member of the group
+* go back to the shared pool of that member.
+*/
+void _cs_evm_release_event(cs_event_manager_t *evm, cs_event_t *ev){
+  cs_evm_pool_t *pool;
+  if(evm->group!=NULL)
+    evm = _cs_evm_pool_owner(evm, ev);
+  pool = _cs_evm_my_pool(evm);
+  if(ev->flags & CS_EV_DATA_OWNED)
+    free(ev->ev_data);
+  ev->flags = 0;
+  ev->etype = NULL;
+  if(pool!=NULL){
+    _cs_evm_pool_put(pool, ev);
+    if(pool->nfree < 2*CS_EVM_POOL_BATCH)
+      return;
+    pthread_mutex_lock(evm->pool_lock);
+    _cs_evm_pool_move(&evm->shared_pool, pool, CS_EVM_POOL_BATCH);
+    pthread_mutex_unlock(evm->pool_lock);
     return;
+  }
+  pthread_mutex_lock(evm->pool_lock);
+  _cs_evm_pool_put(&evm->shared_pool, ev);
+  pthread_mutex_unlock(evm->pool_lock);
+}
 
-  elem = next = list->head;
-  while(elem!=NULL){
-    next = elem->enext;
-    free(elem);
-    elem = next;
+void cs_evm_free_event(cs_event_t *ev, cs_event_manager_t *evm){
+  if(ev==NULL)
+    return;
+  if(!_cs_evm_is_pooled(evm, ev) || ev->pending>0){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_free_event(), the event is not pooled or it is still scheduled");
+    return;
   }
+  _cs_evm_release_event(evm, ev);
+}
 
-  free(list->guards);
-  free(item);
+cs_event_t *cs_evm_alloc_event_data(cs_event_type_t etype, const void *data, size_t size, cs_event_manager_t *evm){
+  cs_event_t *ev;
+  if((ev = cs_evm_alloc_event(etype, NULL, evm))==NULL)
+    return NULL;
+
+  if(size<=CS_EV_INLINE_SIZE)
+    ev->ev_data = CS_EV_INLINE(ev);
+  else if((ev->ev_data = malloc(size))!=NULL)
+    ev->flags |= CS_EV_DATA_OWNED;
+  else{
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error while allocating the payload of an event");
+    _cs_evm_release_event(evm, ev);
+    return NULL;
+  }
+
+  if(data!=NULL)
+    memcpy(ev->ev_data, data, size);
+  else
+    memset(ev->ev_data, 0, size);
+  return ev;
 }
 
 /*
-* Get all event (i.e. an event_list)
-* that must be triggered at specified time.
-**/
-cs_event_list_t *get_events(cs_event_manager_t *evm, cs_clockv time)
-{
-    cs_event_list_t search, *found;
-    search.scheduled_at = time;
+* A schedule of the event ev is over (it has been handled or deleted):
+* a pooled event which is not scheduled anymore goes back to the pool.
+*/
+void _cs_evm_event_done(cs_event_manager_t *evm, cs_event_t *ev){
+  if(_cs_evm_is_pooled(evm, ev) && __sync_sub_and_fetch(&ev->pending, 1)==0)
+    _cs_evm_release_event(evm, ev);
+}
+
+/*
+* Free the chunks of the pooled events.
+*/
+void _cs_evm_destroy_pools(cs_event_manager_t *evm){
+  cs_evm_chunk_index_t *idx = evm->chunks, *next;
+  cs_event_t *ev;
+  int i;
+  if(idx!=NULL)
+    for(i=0; i<idx->n; i++){
+      //payloads of the events still alive
+      for(ev=idx->lo[i]; ev<idx->hi[i]; ev++)
+	if(ev->flags & CS_EV_DATA_OWNED)
+	  free(ev->ev_data);
+      free(idx->lo[i]);
+    }
+  while(idx!=NULL){
+    next = idx->retired;
+    free(idx);
+    idx = next;
+  }
+  evm->chunks = NULL;
+  free(evm->pools);
+  pthread_mutex_destroy(evm->pool_lock);
+  free(evm->pool_lock);
+}
+
+void destroy_event_list(void *item, void *param){
+  cs_event_list_t *list = item;
+  if(list == NULL)
+    return;
+  free(list->evs);
+  free(list);
+}
+
+/*
+* Make room for n more events in the list.
+*/
+int _cs_ev_list_reserve(cs_event_list_t *list, int n){
+  cs_event_t **evs;
+  int size;
+  if(list->count+n<=list->size)
+    return 0;
+  size = MAX(CS_EV_LIST_MIN_SIZE, list->size);
+  while(size<list->count+n)
+    size*=2;
+  if(!(evs = (cs_event_t **) realloc(list->evs, size*sizeof(cs_event_t *)))){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error while growing an event list");
+    return -1;
+  }
+  list->evs = evs;
+  list->size = size;
+  return 0;
+}
 
-    lock_ev_tree(evm);
-    found = rb_find(evm->ev_tree, &search);
-    unlock_ev_tree(evm);
+/*
+* Add the event at the end of the list.
+*/
+int _cs_ev_list_push(cs_event_list_t *list, cs_event_t *ev){
+  if(list->count==list->size && _cs_ev_list_reserve(list, 1)<0)
+    return -1;
+  list->evs[list->count++] = ev;
+  return 0;
+}
 
-    return found;
+/*
+* Append the events of the list src to the list dst.
+* The list src remains empty; when dst is empty the
+* arrays are just swapped.
+*/
+int _cs_ev_list_append(cs_event_list_t *dst, cs_event_list_t *src){
+  cs_event_t **evs;
+  int size;
+  if(src->count==0)
+    return 0;
+  if(dst->count==0){
+    evs = dst->evs; size = dst->size;
+    dst->evs = src->evs; dst->size = src->size;
+    src->evs = evs; src->size = size;
+  }
+  else if(_cs_ev_list_reserve(dst, src->count)<0)
+    return -1;
+  else
+    memcpy(dst->evs+dst->count, src->evs, src->count*sizeof(cs_event_t *));
+  dst->count+=src->count;
+  src->count = 0;
+  return 0;
 }
 
 /*
@@ -98,36 +644,326 @@ cs_event_list_t *new_ev_list(cs_clockv time){
     log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error while allocating cs_event_list_t");
     return NULL;
   }
-  el->head = el->tail = NULL;
-  el->count = 0;
+  el->evs = NULL;
+  el->count = el->size = 0;
   el->scheduled_at = time;
   return el;
 }
 
-cs_event_list_item_t *new_ev_list_item(cs_event_t *ev){
-  cs_event_list_item_t *el = (cs_event_list_item_t *) calloc(1, sizeof(cs_event_list_item_t));
-  if(!el){
-    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error while allocating cs_event_list_item_t");
-    return NULL;
+/*
+* Group the events of the list by type, keeping their order within 
+* each type (counting sort on the type ids). The scratch list buf
+* is filled, and then swapped with the list.
+*/
+void _cs_evm_group_by_type(cs_event_manager_t *evm, cs_event_list_t *list, cs_event_list_t *buf){
+  int start[CS_EVM_MAX_TYPES+1];
+  int ntypes = __atomic_load_n(&evm->ntypes, __ATOMIC_ACQUIRE);
+  cs_event_t **evs;
+  int i, size;
+
+  buf->count = 0;
+  if(list->count<2 || _cs_ev_list_reserve(buf, list->count)<0)
+    return;
+
+  memset(start, 0, (ntypes+1)*sizeof(int));
+  for(i=0; i<list->count; i++)
+    start[list->evs[i]->etid+1]++;
+  for(i=1; i<=ntypes; i++)
+    start[i]+=start[i-1];
+  for(i=0; i<list->count; i++)
+    buf->evs[start[list->evs[i]->etid]++] = list->evs[i];
+
+  evs = list->evs; size = list->size;
+  list->evs = buf->evs; list->size = buf->size;
+  buf->evs = evs; buf->size = size;
+}
+
+/*
+* The digit d of the key of ev in a sorted tick: the digits 0..7 are the
+* bytes of the target (the events without target first), the digit 8 
+* is the type and the digit 9 its priority.
+*/
+int _cs_evm_tick_digit(cs_evm_htab_t *ht, cs_event_t *ev, int d){
+  if(d==9)
+    return ht->priorities[ev->etid]-CS_EVM_MIN_PRIORITY;
+  if(d==8)
+    return ev->etid;
+  return (int) (((ev->target<0 ? 0 : (unsigned long int) ev->target+1) >> (8*d)) & 0xff);
+}
+
+/*
+* Sort the events of a tick by priority of their type, type and target
+* (see cs_evm_conf_t.sort_ticks), with a stable radix sort: a counting 
+* pass for each byte of the greatest target, then one for the type and
+* one for the priority. The passes with a single digit move nothing.
+*/
+void _cs_evm_sort_tick(cs_event_manager_t *evm, cs_event_list_t *list, cs_event_list_t *buf){
+  int count[257];
+  cs_evm_htab_t *ht = __atomic_load_n(&evm->htab, __ATOMIC_ACQUIRE);
+  unsigned long int top = 0;
+  cs_event_t **evs;
+  int i, p, d, nbytes, size;
+
+  buf->count = 0;
+  if(list->count<2 || _cs_ev_list_reserve(buf, list->count)<0)
+    return;
+
+  for(i=0; i<list->count; i++)
+    if(list->evs[i]->target>=0 && (unsigned long int) list->evs[i]->target+1>top)
+      top = (unsigned long int) list->evs[i]->target+1;
+  for(nbytes=0; nbytes<(int) sizeof(unsigned long int) && (top>>(8*nbytes))!=0; nbytes++);
+
+  for(p=0; p<nbytes+2; p++){
+    d = (p<nbytes ? p : 8+p-nbytes);
+    memset(count, 0, sizeof(count));
+    for(i=0; i<list->count; i++)
+      count[_cs_evm_tick_digit(ht, list->evs[i], d)+1]++;
+    for(i=1; i<=256 && count[i]<list->count; i++);
+    if(i<=256)
+      continue;
+    for(i=1; i<=256; i++)
+      count[i]+=count[i-1];
+    for(i=0; i<list->count; i++)
+      buf->evs[count[_cs_evm_tick_digit(ht, list->evs[i], d)]++] = list->evs[i];
+
+    evs = list->evs; size = list->size;
+    list->evs = buf->evs; list->size = buf->size;
+    buf->evs = evs; buf->size = size;
   }
-  el->ev = ev;
-  el->enext = NULL;
-  return el;
 }
 
-void _cs_ev_update_guards(cs_event_list_t *ev_list, int nguards, int *hops){
-  *hops = MAX(1,floor(ev_list->count/nguards));
-  int i,j;
-  cs_event_list_item_t *ptr = ev_list->head;
-  ev_list->guards = (cs_event_list_item_t **) malloc(sizeof(cs_event_list_item_t *)*nguards);
-  for(i=0; i<nguards; i++){
-    ev_list->guards[i]=ptr;
-    for(j=0; j<*hops; j++)
-      if(ptr->enext!=NULL)
-	ptr=ptr->enext;
-      else
-	break;	
+/*
+* Partition the events of the window by target, keeping their order
+* within each partition (counting sort). The events without a target
+* all go to the partition 0. On return evm->win_parts[p] is the first 
+* event of the partition p, and evm->win_parts[nparts] the number of events.
+* @return a value < 0 in the case of memory error.
+*/
+int _cs_evm_group_by_part(cs_event_manager_t *evm, cs_event_list_t *win, int nparts){
+  cs_event_list_t *buf = &evm->sort_buf;
+  cs_clockv *at;
+  cs_event_t **evs;
+  int *start, i, p, size;
+
+  buf->count = 0;
+  if(_cs_ev_list_reserve(buf, win->count)<0 ||
+     !(at = (cs_clockv *) malloc(win->size*sizeof(cs_clockv))) ||
+     !(start = (int *) realloc(evm->win_parts, (nparts+2)*sizeof(int)))){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error partitioning the events of a window");
+    return -1;
+  }
+  evm->win_parts = start;
+
+  memset(start, 0, (nparts+2)*sizeof(int));
+  for(i=0; i<win->count; i++)
+    start[_CS_EVM_PART(win->evs[i], nparts)+1]++;
+  for(p=1; p<=nparts; p++)
+    start[p]+=start[p-1];
+  for(i=0; i<win->count; i++){
+    p = start[_CS_EVM_PART(win->evs[i], nparts)]++;
+    buf->evs[p] = win->evs[i];
+    at[p] = evm->win_at[i];
+  }
+  //the counters now point to the ends of the partitions
+  for(p=nparts; p>0; p--)
+    start[p] = start[p-1];
+  start[0] = 0;
+
+  evs = win->evs; size = win->size;
+  win->evs = buf->evs; win->size = buf->size;
+  buf->evs = evs; buf->size = size;
+  free(evm->win_at);
+  evm->win_at = at;
+  return 0;
+}
+
+/*
+* Whether the entry of ev at the time at is live: a schedule by handle
+* is claimed (it cannot be cancelled anymore), a tombstone is not.
+*/
+short int _cs_evm_claim_event(cs_event_manager_t *evm, cs_event_t *ev, cs_clockv at){
+  unsigned int gen;
+  if(!_cs_evm_is_pooled(evm, ev) || !(ev->flags & CS_EV_HANDLED))
+    return 1;
+  //the live schedule (odd generation) is claimed, as by cs_evm_cancel
+  gen = __atomic_load_n(&ev->gen, __ATOMIC_ACQUIRE);
+  if(!(gen & 1) || __atomic_load_n(&ev->sched_at, __ATOMIC_ACQUIRE)!=at || 
+     !__sync_bool_compare_and_swap(&ev->gen, gen, gen+1))
+    return 0;
+  __atomic_store_n(&ev->sched_at, -1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+/*
+* Drop the events of list, scheduled at the time at, which cannot be
+* stored: their schedules are over, as if they had been handled.
+*/
+void _cs_evm_drop_events(cs_event_manager_t *evm, cs_event_list_t *list, cs_clockv at){
+  int i;
+  log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "%d events scheduled at %li lost while merging", list->count, (long int) at);
+  for(i=0; i<list->count; i++){
+    _cs_evm_claim_event(evm, list->evs[i], at);
+    _cs_evm_event_done(evm, list->evs[i]);
   }
+  list->count = 0;
+}
+
+/*
+* Run the batch handler bh of a type on its n events evs, with the
+* subscribers of the type around each event.
+*/
+cs_eh_status _cs_evm_dispatch_batch(cs_event_manager_t *evm, cs_evm_htab_t *ht, cs_event_batch_handler_t bh, cs_event_t **evs, int n){
+  cs_evm_chain_t *chain = ht->chains[evs[0]->etid];
+  unsigned long long t0;
+  cs_eh_status ret;
+  int i;
+
+  if(chain!=NULL)
+    for(i=0; i<n; i++)
+      _cs_evm_run_subscribers(evm, chain, evs[i], 0, chain->split);
+  if(_cs_evm_stats_on(evm)){
+    t0 = cs_stats_now_ns();
+    ret = bh(evs, (size_t) n, evm);
+    _cs_evstats_handled(evm, _cs_evm_task_index(evm), evs[0]->etid, n, cs_stats_now_ns()-t0);
+  }
+  else
+    ret = bh(evs, (size_t) n, evm);
+  if(chain!=NULL)
+    for(i=0; i<n; i++)
+      _cs_evm_run_subscribers(evm, chain, evs[i], chain->split, chain->n);
+  return ret;
+}
+
+/*
+* Dispatch the events evs[first..last), scheduled at the time at, and 
+* then release them. The runs of events of a type with a batch handler 
+* are passed to the batch handler. The tombstones are dropped.
+*/
+void _cs_evm_dispatch_range(cs_event_manager_t *evm, cs_event_t **evs, int first, int last, cs_clockv at){
+  cs_evm_htab_t *ht = __atomic_load_n(&evm->htab, __ATOMIC_ACQUIRE);
+  cs_event_batch_handler_t bh = NULL;
+  int c, end;
+
+  //the range belongs to the caller: compact it in place
+  for(c=end=first; c<last; c++)
+    if(_cs_evm_claim_event(evm, evs[c], at))
+      evs[end++] = evs[c];
+    else
+      _cs_evm_event_done(evm, evs[c]);
+  last = end;
+
+  if(evm->trace!=NULL && last>first)
+    _cs_trace_events(evm, evs+first, last-first, at);
+
+  for(c=first; c<last; c=end){
+    end = c+1;
+    if(ht->nbatch_handlers>0)
+      bh = ht->batch_handlers[evs[c]->etid];
+    if(bh!=NULL){
+      while(end<last && evs[end]->etid==evs[c]->etid)
+	end++;
+      _cs_evm_dispatch_batch(evm, ht, bh, evs+c, end-c);
+    }
+    else
+      _cs_evm_dispatch(evm, evs[c]);
+    for(; c<end; c++)
+      _cs_evm_event_done(evm, evs[c]);
+  }
+}
+
+/*
+* Append the event to the schedule buffer, in the run 
+* of the time at.
+* @return a value < 0 if the buffer is full. 
+*/
+int _cs_evm_wbuf_append(cs_evm_wbuf_t *buf, cs_event_t *ev, cs_clockv at){
+  cs_event_list_t *run = &buf->runs[buf->last];
+  int i;
+
+  if(buf->nruns==0 || run->scheduled_at!=at){
+    for(i=0, run=NULL; i<buf->nruns && run==NULL; i++)
+      if(buf->runs[i].scheduled_at==at)
+	run = &buf->runs[(buf->last = i)];
+
+    if(run==NULL && buf->nruns==CS_EVM_WBUF_RUNS)
+      return -1;
+    else if(run==NULL){
+      run = &buf->runs[(buf->last = buf->nruns++)];
+      run->count = 0;
+      run->scheduled_at = at;
+    }
+  }
+
+  return _cs_ev_list_push(run, ev);
+}
+
+/*
+* Add n to the number of events of the shard, whose lock is held.
+*/
+void _cs_evm_shard_count(cs_event_shard_t *shard, long int n){
+  __atomic_store_n(&shard->count, shard->count+n, __ATOMIC_RELEASE);
+}
+
+/*
+* Merge the schedule buffer buf into a shard of evm, with a single lock.
+*/
+void _cs_evm_merge_wbuf(cs_event_manager_t *evm, cs_evm_wbuf_t *buf, cs_event_shard_t *shard){
+  cs_event_list_t *found;
+  int r, n;
+
+  lock_shard(shard);
+  for(r=0; r<buf->nruns; r++){
+    if((found = cs_evstore_find(shard->store, buf->runs[r].scheduled_at))==NULL &&
+       (found = new_ev_list(buf->runs[r].scheduled_at))!=NULL)
+      cs_evstore_insert(shard->store, found);
+    n = buf->runs[r].count;
+    //the runs left are dropped once the shard is unlocked
+    if(found!=NULL && _cs_ev_list_append(found, &buf->runs[r])==0)
+      _cs_evm_shard_count(shard, n);
+  }
+  unlock_shard(shard);
+  for(r=0; r<buf->nruns; r++)
+    if(buf->runs[r].count>0)
+      _cs_evm_drop_events(evm, &buf->runs[r], buf->runs[r].scheduled_at);
+  buf->nruns = buf->last = 0;
+}
+
+/*
+* Merge the schedule buffers of the workers into the shards,
+* with a single lock for each buffer. 
+*/
+void _cs_evm_merge_wbufs(cs_event_manager_t *evm){
+  int i;
+  for(i=0; i<evm->nwbufs; i++)
+    if(evm->wbufs[i].nruns>0)
+      _cs_evm_merge_wbuf(evm, &evm->wbufs[i], &evm->shards[i % evm->nshards]);
+}
+
+void cs_evm_default_conf(cs_evm_conf_t *conf){
+  conf->nshards = 0;
+  conf->store = CS_EVSTORE_RBTREE;
+  conf->lookahead = 1;
+  conf->affinity = 0;
+  conf->spill_horizon = 0;
+  conf->spill_path = NULL;
+  conf->sort_ticks = 0;
+}
+
+/*
+* Create the shards of the pending events.
+*/
+int _cs_evm_init_shards(cs_event_manager_t *evm, int nshards, cs_evstore_type store){
+  int i;
+  evm->nshards = nshards;
+  if(!(evm->shards = (cs_event_shard_t *) calloc(nshards, sizeof(cs_event_shard_t))))
+    return -1;
+  for(i=0; i<nshards; i++){
+    if(!(evm->shards[i].store = cs_evstore_create(store)))
+      return -1;
+    if(!(evm->shards[i].lock = cs_make_mutex()))
+      return -1;
+  }
+  return 0;
 }
 
 int cs_init_event_manager(
@@ -136,27 +972,75 @@ int cs_init_event_manager(
   cs_timer_t *timer,
   sim_type_t type)
 {
+  return cs_init_event_manager_conf(evm, nworkers, timer, type, NULL);
+}
+
+int cs_init_event_manager_conf(
+  cs_event_manager_t *evm,
+  int nworkers,
+  cs_timer_t *timer,
+  sim_type_t type,
+  const cs_evm_conf_t *conf)
+{
+  cs_evm_conf_t def_conf;
   if(evm==NULL)
     return -1;
 
+  if(conf==NULL){
+    cs_evm_default_conf(&def_conf);
+    conf = &def_conf;
+  }
+
   evm->stype = type;
   evm->running = 0;
   evm->stop = 0;
 
-  //create the event handler table
-  if(!(evm->eh_tree = rb_create(cmp_handler_func, NULL, &rb_allocator_default))){
-    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_FATAL, "Impossible to initiate handler table/tree");
+  //no event types yet
+  evm->ntypes = 0;
+  memset(evm->type_names, 0, sizeof(evm->type_names));
+  evm->chains = NULL;
+  if(!(evm->htab = (cs_evm_htab_t *) calloc(1, sizeof(cs_evm_htab_t)))){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_FATAL, "Memory error allocating the handler table");
     return -1;
   }
-  //create the event-list' tree
-  if(!(evm->ev_tree = rb_create(cmp_event_list, NULL, &rb_allocator_default))){
-    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_FATAL, "Impossible to initiate event tree");
+  memset(&evm->sort_buf, 0, sizeof(cs_event_list_t));
+  evm->sort_ticks = conf->sort_ticks;
+  evm->lookahead = MAX(1, conf->lookahead);
+  memset(&evm->win, 0, sizeof(cs_event_list_t));
+  evm->win_at = NULL;
+  evm->win_parts = NULL;
+  evm->affinity = conf->affinity;
+  evm->boxes = NULL;
+  evm->tw = NULL;
+  evm->group = NULL;
+  evm->member = 0;
+  evm->outboxes = NULL;
+  memset(evm->type_cache, 0, sizeof(evm->type_cache));
+
+  evm->trace = NULL;
+  evm->evstats = NULL;
+
+  //the far-future tier, not smaller than a window
+  evm->spill = NULL;
+  if(conf->spill_horizon>0 && _cs_spill_init(evm, MAX(conf->spill_horizon, evm->lookahead), conf->spill_path)<0)
+    return -1;
+
+  //no periodic events yet
+  memset(&evm->wheel, 0, sizeof(cs_evm_wheel_t));
+  evm->wheel.now = -1;
+  if(!(evm->wheel.lock = cs_make_mutex())){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_FATAL, "Impossible to initiate the mutex of the periodic events");
     return -1;
   }
 
-  //create the mutex for the event tree  
-  if(!(evm->ev_tree_lock = cs_make_recursive_mutex())){
-    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_FATAL, "Impossible to initiate event tree mutex");
+  //create the event handler table
+  if(!(evm->eh_tree = rb_create(cmp_handler_func, NULL, &rb_allocator_default))){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_FATAL, "Impossible to initiate handler table/tree");
+    return -1;
+  }
+  //create the shards of the event-lists' tree
+  if(_cs_evm_init_shards(evm, (conf->nshards > 0 ? conf->nshards : MAX(1,nworkers)), conf->store)<0){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_FATAL, "Impossible to initiate event tree shards");
     return -1;
   }
 
@@ -195,24 +1079,62 @@ int cs_init_event_manager(
     log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_FATAL, "Impossible to initiate workerpool for event manager");
     return -1;
   }
+
+  //create the schedule buffers, one for each task of the controller
+  evm->nwbufs = MAX(1, evm->nworkers-1);
+  if(!(evm->wbufs = (cs_evm_wbuf_t *) calloc(evm->nwbufs, sizeof(cs_evm_wbuf_t)))){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_FATAL, "Memory error allocating schedule buffers for event manager");
+    return -1;
+  }
+
+  //create the pools of events, one for each task of the controller
+  evm->shared_pool.free = NULL;
+  evm->shared_pool.nfree = 0;
+  evm->chunks = NULL;
+  if(!(evm->pools = (cs_evm_pool_t *) calloc(evm->nwbufs, sizeof(cs_evm_pool_t))) ||
+     !(evm->pool_lock = cs_make_recursive_mutex())){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_FATAL, "Memory error allocating event pools for event manager");
+    return -1;
+  }
   return 0;
 }
 
 cs_wp_tsk_exit_status _ev_worker (cs_data_ptr in, cs_data_ptr *out){
   cs_wp_tsk_exit_status myret = CS_TSK_SUCCESS;
   //cs_eh_status ret;
-  int c;
+  int first, last;
   event_worker_data_t *myargs = (event_worker_data_t *) in;
-  cs_event_list_item_t *cur_ev = myargs->ev_list->guards[myargs->guard_index];
-  for(c=0; c<myargs->num_events; c++){
-    if(cur_ev==NULL){
-      fprintf(stderr, "\n cur-ev is NULL, c=%d, index=%d", c, myargs->guard_index);
-      exit(-1);
+  cs_event_t **evs = myargs->ev_list->evs;
+  int count = myargs->ev_list->count;
+  _cs_evm_worker_ctx ctx;
+
+  //events scheduled by the handlers go to the buffer of this task
+  ctx.evm = myargs->evm;
+  ctx.index = myargs->index;
+  ctx.now = ctx.ev_now = myargs->now;
+  ctx.send = NULL;
+  ctx.send_arg = NULL;
+  _cs_evm_ctx = &ctx;
+
+  if(myargs->at!=NULL){
+    //window: claim whole partitions, handled in time order
+    while((first = __sync_fetch_and_add(myargs->cursor, 1))<myargs->nparts)
+      for(last=myargs->parts[first]; last<myargs->parts[first+1]; last++){
+	ctx.ev_now = myargs->at[last];
+	_cs_evm_dispatch_range(myargs->evm, evs, last, last+1, ctx.ev_now);
+      }
+  }
+  else{
+    //the mailbox of the task, if any
+    if(myargs->parts!=NULL)
+      _cs_evm_dispatch_range(myargs->evm, evs, myargs->parts[myargs->index], myargs->parts[myargs->index+1], myargs->now);
+    //claim chunks of events until the list is over
+    while((first = __sync_fetch_and_add(myargs->cursor, myargs->chunk))<count){
+      last = MIN(first+myargs->chunk, count);
+      _cs_evm_dispatch_range(myargs->evm, evs, first, last, myargs->now);
     }
-    assert(cur_ev!=NULL);
-    cs_evm_throw_event(myargs->evm, cur_ev->ev);
-    cur_ev = cur_ev->enext;
   }
+  _cs_evm_ctx = NULL;
   //ret = cs_evm_throw_event(myargs->evm, myargs->ev);
   /*
     CS_EH_NORMAL,
@@ -289,22 +1211,288 @@ void _set_evm_not_running(cs_event_manager_t *evm){
   pthread_mutex_unlock(evm->mutex);
 }
 
-void wait_event_completion(cs_event_manager_t *evm, cs_clockv clock){
-  _LOCK_MUTEX(evm->wait_mutex);
+void wait_event_completion(cs_event_manager_t *evm, cs_clockv clock){
+  _LOCK_MUTEX(evm->wait_mutex);
+
+  if(evm->last_completion<clock)
+    pthread_cond_wait(&evm->wait_cond, evm->wait_mutex); //TODO fields
+
+  _UNLOCK_MUTEX(evm->wait_mutex);
+}
+
+void _signal_event_completion(cs_event_manager_t *evm, cs_clockv clock){
+  _LOCK_MUTEX(evm->wait_mutex);
+
+  evm->last_completion=clock; //TODO field
+  pthread_cond_broadcast(&evm->wait_cond);
+
+  _UNLOCK_MUTEX(evm->wait_mutex);
+}
+
+/*
+* Pop all the events scheduled before end, and put them in the 
+* scratch list of the window, in time order; the times of the events
+* go to evm->win_at.
+* @return a value < 0 in the case of memory error.
+*/
+int _cs_evm_gather_window(cs_event_manager_t *evm, cs_clockv end){
+  cs_event_list_t *win = &evm->win, *found;
+  cs_clockv next, *at;
+  int i;
+
+  win->count = 0;
+  while((next = cs_evm_find_nearest_events(evm))>=0 && next<end){
+    if((found = pop_events(evm, next))==NULL)
+      continue;
+    i = win->count;
+    if(_cs_ev_list_append(win, found)<0 ||
+       !(at = (cs_clockv *) realloc(evm->win_at, win->size*sizeof(cs_clockv)))){
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error gathering the events before %li", (long int) end);
+      destroy_event_list(found, NULL);
+      return -1;
+    }
+    evm->win_at = at;
+    for(; i<win->count; i++)
+      at[i] = next;
+    destroy_event_list(found, NULL);
+  }
+  return 0;
+}
+
+/*
+* Run the handler of ev at the time at, as the task index of 
+* the controller: the batch handler of its type, if any, with a
+* batch of one event. The events scheduled by the handler are given 
+* to the hook send. Then the event is not released: it is up 
+* to the caller, through _cs_evm_event_done.
+*/
+cs_eh_status _cs_evm_run_handler(cs_event_manager_t *evm, cs_event_t *ev, cs_clockv at, int index, cs_evm_send_hook_t send, void *send_arg){
+  cs_evm_htab_t *ht = __atomic_load_n(&evm->htab, __ATOMIC_ACQUIRE);
+  _cs_evm_worker_ctx ctx, *prev = _cs_evm_ctx;
+  cs_event_batch_handler_t bh = NULL;
+  cs_eh_status ret;
+  ctx.evm = evm;
+  ctx.index = index;
+  ctx.now = ctx.ev_now = at;
+  ctx.send = send;
+  ctx.send_arg = send_arg;
+  _cs_evm_ctx = &ctx;
+  if(ht->nbatch_handlers>0 && ev->etid>=0 && ev->etid<CS_EVM_MAX_TYPES)
+    bh = ht->batch_handlers[ev->etid];
+  ret = (bh!=NULL ? _cs_evm_dispatch_batch(evm, ht, bh, &ev, 1) : _cs_evm_dispatch(evm, ev));
+  _cs_evm_ctx = prev;
+  return ret;
+}
+
+/*
+* Insert the event in the shard of the current thread, at the time at,
+* without counting a new schedule of it.
+*/
+int _cs_evm_store_event(cs_event_manager_t *evm, cs_event_t *ev, cs_clockv at){
+  cs_event_shard_t *shard = _cs_evm_my_shard(evm);
+  cs_event_list_t *found;
+  int ret = 0;
+
+  lock_shard(shard);
+  if((found = cs_evstore_find(shard->store, at))==NULL &&
+     (found = new_ev_list(at))!=NULL)
+    cs_evstore_insert(shard->store, found);
+  if(found==NULL || _cs_ev_list_push(found, ev)<0)
+    ret = -1;
+  else
+    _cs_evm_shard_count(shard, 1);
+  unlock_shard(shard);
+  return ret;
+}
+
+/*
+* Handle all the events in the window [cur_time, cur_time+lookahead).
+* The events are partitioned by target, keeping the time order in each
+* partition; the tasks of the workerpool claim whole partitions.
+* @return a value < 0 in the case of error.
+*/
+int _cs_evm_run_window(cs_event_manager_t *evm, cs_clockv cur_time){
+  cs_event_list_t *win = &evm->win;
+  event_worker_data_t *args;
+  cs_wp_tsk_id *id_arr;
+  int ntasks = evm->nworkers-1, nparts, bound, c, ret = 0;
+  int cursor __attribute__((aligned(CS_CACHE_LINE)));
+  int *start;
+
+  //gather the events of the window, in time order
+  if(_cs_evm_gather_window(evm, cur_time+evm->lookahead)<0)
+    return -1;
+  if(win->count==0)
+    return 0;
+
+  //counting sort of the events by partition (stable, i.e. in time order)
+  nparts = MIN(4*ntasks, win->count);
+  if(_cs_evm_group_by_part(evm, win, nparts)<0)
+    return -1;
+  start = evm->win_parts;
+
+  bound = MIN(ntasks, nparts);
+  args = (event_worker_data_t *) calloc(ntasks,sizeof(event_worker_data_t));
+  id_arr = (cs_wp_tsk_id *) calloc(ntasks,sizeof(cs_wp_tsk_id));
+  cursor = 0;
+  for(c=0; c<bound; c++){
+    args[c].ev_list = win;
+    args[c].evm = evm;
+    args[c].cursor = &cursor;
+    args[c].chunk = 1;
+    args[c].index = c;
+    args[c].now = cur_time+evm->lookahead-1;
+    args[c].at = evm->win_at;
+    args[c].parts = start;
+    args[c].nparts = nparts;
+    if((id_arr[c] = cs_wp_tsk_enqueue(_ev_worker, (void *) &args[c], sizeof(event_worker_data_t), evm->wp))<0){
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR,\
+	"Impossible to enqueue task for the window at %li", (long int) cur_time);
+      ret = -1;
+    }
+  }
+
+  for(c=0; c<bound; c++)
+    cs_wp_tsk_wait(evm->wp, id_arr[c]);
+
+  //bulk-insert the events scheduled by the handlers
+  _cs_evm_merge_wbufs(evm);
+
+  win->count = 0;
+  free(id_arr);
+  free(args);
+  return ret;
+}
+
+/*
+* Route the events of the tick to the mailboxes of the ntasks tasks,
+* by target, keeping their order (counting sort). On return the mailbox
+* of the task c is [evm->boxes[c], evm->boxes[c+1]), and the events 
+* without target follow, from evm->boxes[ntasks].
+* @return a value < 0 in the case of memory error.
+*/
+int _cs_evm_route_mailboxes(cs_event_manager_t *evm, cs_event_list_t *list, int ntasks){
+  cs_event_list_t *buf = &evm->sort_buf;
+  cs_event_t **evs;
+  int *start, i, b, size;
+
+  buf->count = 0;
+  if(_cs_ev_list_reserve(buf, list->count)<0 ||
+     !(start = (int *) realloc(evm->boxes, (ntasks+2)*sizeof(int)))){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error routing the events to the mailboxes");
+    return -1;
+  }
+  evm->boxes = start;
+
+  //the events without target go to the box ntasks
+  memset(start, 0, (ntasks+2)*sizeof(int));
+  for(i=0; i<list->count; i++)
+    start[(list->evs[i]->target<0 ? ntasks : _CS_EVM_PART(list->evs[i], ntasks))+1]++;
+  for(b=1; b<=ntasks+1; b++)
+    start[b]+=start[b-1];
+  for(i=0; i<list->count; i++)
+    buf->evs[start[(list->evs[i]->target<0 ? ntasks : _CS_EVM_PART(list->evs[i], ntasks))]++] = list->evs[i];
+  //the counters now point to the ends of the boxes
+  for(b=ntasks+1; b>0; b--)
+    start[b] = start[b-1];
+  start[0] = 0;
+
+  evs = list->evs; size = list->size;
+  list->evs = buf->evs; list->size = buf->size;
+  buf->evs = evs; buf->size = size;
+  return 0;
+}
+
+/*
+* Handle the events of ev_list, all scheduled at cur_time: the tasks 
+* claim small chunks of events, so that expensive handlers do not 
+* leave the other workers idle. With affinity each task first handles
+* its mailbox, and then claims the events without target.
+* @return a value < 0 in the case of error.
+*/
+int _cs_evm_run_tick(cs_event_manager_t *evm, cs_event_list_t *ev_list, cs_clockv cur_time){
+  event_worker_data_t *args;
+  cs_wp_tsk_id *id_arr;
+  int ntasks = evm->nworkers-1, bound, chunk, c, ret = 0;
+  int cursor __attribute__((aligned(CS_CACHE_LINE)));
+  int *boxes = NULL, shared = ev_list->count;
+
+  log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_TRACE, "ev-control: ev-list-count %li", (long int) ev_list->count);
+  bound = MIN(ntasks, ev_list->count);
+  if(evm->sort_ticks)
+    _cs_evm_sort_tick(evm, ev_list, &evm->sort_buf);
+  else if(__atomic_load_n(&evm->htab, __ATOMIC_ACQUIRE)->nbatch_handlers>0)
+    _cs_evm_group_by_type(evm, ev_list, &evm->sort_buf);
+  cursor = 0;
+  //the grouping by type is kept within each mailbox
+  if(evm->affinity && _cs_evm_route_mailboxes(evm, ev_list, ntasks)==0){
+    boxes = evm->boxes;
+    cursor = boxes[ntasks];
+    shared = ev_list->count-cursor;
+    bound = ntasks;
+  }
+  chunk = MAX(1, MIN(CS_EVM_CLAIM_CHUNK, shared/(MIN(ntasks, MAX(1, shared))*8)));
+  //allocate count arguments for workers
+  args = (event_worker_data_t *) calloc(ntasks,sizeof(event_worker_data_t));
+  id_arr = (cs_wp_tsk_id *) calloc(ntasks,sizeof(cs_wp_tsk_id));
+  for(c=0; c<bound; c++){ //will schedule at most evm->nworkers-1 tasks
+    //no task for an empty mailbox, unless it has to help with the shared events
+    if(boxes!=NULL && boxes[c]==boxes[c+1] && c>=shared){
+      id_arr[c] = -1;
+      continue;
+    }
+    args[c].ev_list = ev_list;
+    args[c].parts = boxes;
+    args[c].nparts = ntasks;
+    args[c].evm = evm;
+    args[c].cursor = &cursor;
+    args[c].chunk = chunk;
+    args[c].index = c;
+    args[c].now = cur_time;
+    if((id_arr[c] = cs_wp_tsk_enqueue(_ev_worker, (void *) &args[c], sizeof(event_worker_data_t), evm->wp))<0){
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR,\
+	"Impossible to enqueue task for an event to be raised at %d", ev_list->scheduled_at);
+      ret = -1;
+    }
+  }
 
-  if(evm->last_completion<clock)
-    pthread_cond_wait(&evm->wait_cond, evm->wait_mutex); //TODO fields
+  //wait for the completion of the event handlers
+  for(c=0; c<bound; c++)
+    if(id_arr[c]>=0)
+      cs_wp_tsk_wait(evm->wp, id_arr[c]);
 
-  _UNLOCK_MUTEX(evm->wait_mutex);
-}
+  //bulk-insert the events scheduled by the handlers
+  _cs_evm_merge_wbufs(evm);
 
-void _signal_event_completion(cs_event_manager_t *evm, cs_clockv clock){
-  _LOCK_MUTEX(evm->wait_mutex);
+  //frees memory previously allocated
+  free(id_arr);
+  free(args);
+  return ret;
+}
 
-  evm->last_completion=clock; //TODO field
-  pthread_cond_broadcast(&evm->wait_cond);
+/*
+* Store the events of list at the time at, emptying it.
+*/
+void _cs_evm_defer_events(cs_event_manager_t *evm, cs_event_list_t *list, cs_clockv at){
+  int i;
+  log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_WARN, "%i events deferred to %li", list->count, (long int) at);
+  for(i=0; i<list->count; i++)
+    if(_cs_evm_store_event(evm, list->evs[i], at)<0)
+      _cs_evm_event_done(evm, list->evs[i]);
+  list->count = 0;
+}
 
-  _UNLOCK_MUTEX(evm->wait_mutex);
+/*
+* Move the events of the delta cycle just ended from the buffers 
+* of the workers to list.
+*/
+void _cs_evm_gather_deltas(cs_event_manager_t *evm, cs_event_list_t *list){
+  int i;
+  for(i=0; i<evm->nwbufs; i++)
+    if(_cs_ev_list_append(list, &evm->wbufs[i].delta)<0){
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error gathering a delta cycle, events deferred");
+      _cs_evm_defer_events(evm, &evm->wbufs[i].delta, list->scheduled_at+1);
+    }
 }
 
 /*
@@ -316,17 +1504,13 @@ cs_wp_tsk_exit_status _ev_controller(cs_data_ptr in, cs_data_ptr *out){
   cs_event_manager_t *evm = (cs_event_manager_t *) in;
   cs_clockv start = evm->start_time;
   cs_clockv cur_time = cs_get_clock(evm->timer);
+  cs_clockv next;
   cs_event_list_t *ev_list;
-  //cs_event_list_item_t *ev_item;
-  event_worker_data_t *args;
   cs_wp_tsk_exit_status ex_st = CS_TSK_SUCCESS;
-  cs_wp_tsk_id *id_arr;
+  cs_clockv sent = -1; //the nearest event sent to the other members of the group
   //cs_clockv prev_time = cur_time;
-  int c;
-  int hops;
-  int ntasks = evm->nworkers-1;
   int ret_sync;
-  int bound;
+  int delta;
 
   _evm_set_running(evm);
 
@@ -334,7 +1518,15 @@ cs_wp_tsk_exit_status _ev_controller(cs_data_ptr in, cs_data_ptr *out){
     //(cur_time > prev_time ? log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_TRACE, "ev-control: cur-time: %li", (long int) cur_time) : 1);
 
     log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_NOTICE, "(t=%li) - Ev-controller: syncing..", cs_get_clock(evm->timer));
-    ret_sync = cs_time_sync(evm->timer); //wait for the next tick of clock
+    //wait for the next tick of clock, or for the nearest events if 
+    //nobody else has anything to do before them
+    next = cs_evm_find_nearest_events(evm);
+    if(sent>=0 && (next<0 || sent<next))
+      next = sent;
+    sent = -1;
+    if(next>=0 && next<start)
+      next = start;
+    ret_sync = cs_time_sync_to(evm->timer, (next>=0 ? next : 0));
     if(ret_sync<0) //simulation stopped
       break;
     cur_time = cs_get_clock(evm->timer);
@@ -345,38 +1537,45 @@ cs_wp_tsk_exit_status _ev_controller(cs_data_ptr in, cs_data_ptr *out){
     else if(start>cur_time)
       continue;
 
-    if((ev_list = pop_events(evm, cur_time))!= NULL && (bound = ev_list->count)>0){
-      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_TRACE, "ev-control: ev-list-count %li", (long int) ev_list->count);
-      _cs_ev_update_guards(ev_list, ntasks, &hops); //update guards
-      //allocate count arguments for workers
-      args = (event_worker_data_t *) calloc(ntasks,sizeof(event_worker_data_t));
-      id_arr = (cs_wp_tsk_id *) calloc(ntasks,sizeof(cs_wp_tsk_id));
-      c = 0;
-      while(c<MIN(ntasks,bound)){ //will schedule evm->nworkers-1 tasks
-	args[c].ev_list = ev_list;
-	args[c].evm = evm;
-	args[c].num_events = (c<ntasks-1 ? hops : ev_list->count-(ntasks-1)*hops);
-	args[c].guard_index = c;
-	if((id_arr[c] = cs_wp_tsk_enqueue(_ev_worker, (void *) &args[c], sizeof(event_worker_data_t), evm->wp))<0){
-	  log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR,\
-	    "Impossible to enqueue task for an event to be raised at %d", ev_list->scheduled_at);
-	  ex_st = CS_TSK_ERROR;
+    //the spilled events are back before their window
+    _cs_spill_page_in(evm, cur_time);
+
+    if(evm->tw!=NULL){
+      if(_cs_tw_run_window(evm, cur_time)<0)
+	ex_st = CS_TSK_ERROR;
+    }
+
+    else if(evm->lookahead>1){
+      if(_cs_evm_run_window(evm, cur_time)<0)
+	ex_st = CS_TSK_ERROR;
+    }
+
+    else if((ev_list = pop_events(evm, cur_time))!= NULL && ev_list->count>0){
+      //the events scheduled by the handlers for the current tick 
+      //are raised by the next delta cycle, without syncing the timer
+      for(delta=0; ev_list->count>0; delta++){
+	if(delta==CS_EVM_MAX_DELTA_CYCLES){
+	  _cs_evm_defer_events(evm, ev_list, cur_time+1);
+	  break;
 	}
-	//ev_item = ev_item->enext;
-	c++;
+	if(_cs_evm_run_tick(evm, ev_list, cur_time)<0)
+	  ex_st = CS_TSK_ERROR;
+	ev_list->count = 0;
+	_cs_evm_gather_deltas(evm, ev_list);
       }
 
-      //wait for the completion of the event handlers
-      for(c=0; c<MIN(ntasks,bound); c++)
-	cs_wp_tsk_wait(evm->wp, id_arr[c]);
-
       //destroy the event list
       destroy_event_list(ev_list, NULL);
-
-      //frees memory previously allocated
-      free(id_arr);
-      free(args);
     }
+    else
+      destroy_event_list(ev_list, NULL);
+
+    //the other members see the events sent to them before the tick is over
+    if(evm->group!=NULL)
+      sent = _cs_evgroup_flush(evm);
+
+    if(evm->evstats!=NULL)
+      _cs_evstats_dump(evm, cur_time);
 
     //signal the completion of events for the current clock
     _signal_event_completion(evm, cur_time);
@@ -425,6 +1624,9 @@ if(cs_evm_running(evm))
 */
 void cs_destroy_event_manager(cs_event_manager_t *evm)
 {
+  cs_evm_htab_t *ht;
+  cs_evm_chain_t *chain;
+  int i, j;
   _cs_shutdown_event_manager(evm);
 
   //destroy workerpool and event controller data
@@ -434,11 +1636,46 @@ void cs_destroy_event_manager(cs_event_manager_t *evm)
 
   //destroy data
   rb_destroy(evm->eh_tree, destroy_handler_entry);
-  rb_destroy(evm->ev_tree, destroy_event_list);
+  for(i=0; i<evm->nshards; i++){
+    cs_evstore_destroy(evm->shards[i].store, destroy_event_list);
+    pthread_mutex_destroy(evm->shards[i].lock);
+    free(evm->shards[i].lock);
+  }
+  free(evm->shards);
+  for(i=0; i<evm->nwbufs; i++){
+    for(j=0; j<CS_EVM_WBUF_RUNS; j++)
+      free(evm->wbufs[i].runs[j].evs);
+    free(evm->wbufs[i].delta.evs);
+  }
+  free(evm->wbufs);
+  if(evm->outboxes!=NULL){
+    for(i=0; i<evm->nwbufs*evm->group->nmembers; i++)
+      for(j=0; j<CS_EVM_WBUF_RUNS; j++)
+	free(evm->outboxes[i].runs[j].evs);
+    free(evm->outboxes);
+  }
+  free(evm->sort_buf.evs);
+  _cs_tw_destroy(evm);
+  free(evm->win.evs);
+  free(evm->win_at);
+  free(evm->win_parts);
+  free(evm->boxes);
+  _cs_spill_destroy(evm);
+  _cs_trace_destroy(evm);
+  _cs_evstats_destroy(evm);
+  _cs_evm_destroy_wheel(evm);
+  _cs_evm_destroy_pools(evm);
+
+  while((ht = evm->htab)!=NULL){
+    evm->htab = ht->retired;
+    free(ht);
+  }
+  while((chain = evm->chains)!=NULL){
+    evm->chains = chain->retired;
+    free(chain);
+  }
 
   //destroy mutexes
-  pthread_mutex_destroy(evm->ev_tree_lock);
-  free(evm->ev_tree_lock);
   pthread_mutex_destroy(evm->eh_tree_lock);
   free(evm->eh_tree_lock);
 }
@@ -448,15 +1685,10 @@ void cs_destroy_event_manager(cs_event_manager_t *evm)
 */
 cs_event_handler_t cs_evm_get_handler(cs_event_type_t etype, cs_event_manager_t *evm)
 {
-  cs_event_handler_entry_t search, *ret;
-  search.etype = etype;
-  lock_eh_tree(evm);
-  ret = (cs_event_handler_entry_t *) rb_find(evm->eh_tree, &search);
-  unlock_eh_tree(evm);
-  if(ret!=NULL)
-    return ret->handler;
-  else
+  int etid = _cs_evm_resolve_type(evm, etype, 0);
+  if(etid<0)
     return NULL;
+  return __atomic_load_n(&evm->htab, __ATOMIC_ACQUIRE)->handlers[etid];
 }
 
 /**
@@ -467,29 +1699,163 @@ int cs_evm_install_handler(
   cs_event_handler_t handler,
   cs_event_manager_t *evm)
 {
-  cs_event_handler_entry_t search, *new_entry;
+  cs_event_handler_entry_t *entry;
+  cs_evm_htab_t *ht;
   if(etype==NULL || strlen((const char *) etype)==0){
     log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_install_handler(), parameter etype cannot be null or empty!");
     return -1;
   }
 
-  search.etype = etype;
   lock_eh_tree(evm);
+  if((entry = _cs_evm_type_entry(evm, etype, 1))==NULL || (ht = _cs_evm_htab_copy(evm))==NULL){
+    unlock_eh_tree(evm);
+    return -1;
+  }
+  if(entry->handler!=NULL && handler!=NULL && entry->handler!=handler)
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_NOTICE, "Replacing the handler of the event type %s (see cs_evm_subscribe)", etype);
+  entry->handler = handler;
+  ht->handlers[entry->etid] = handler;
+  _cs_evm_htab_publish(evm, ht);
+  unlock_eh_tree(evm);
+  return 0;
+}
+
+int cs_evm_install_batch_handler(
+  cs_event_type_t etype,
+  cs_event_batch_handler_t handler,
+  cs_event_manager_t *evm)
+{
+  cs_event_handler_entry_t *entry;
+  cs_evm_htab_t *ht;
+  if(etype==NULL || strlen((const char *) etype)==0){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_install_batch_handler(), parameter etype cannot be null or empty!");
+    return -1;
+  }
+
+  lock_eh_tree(evm);
+  if((entry = _cs_evm_type_entry(evm, etype, 1))==NULL || (ht = _cs_evm_htab_copy(evm))==NULL){
+    unlock_eh_tree(evm);
+    return -1;
+  }
+  if(ht->batch_handlers[entry->etid]==NULL && handler!=NULL)
+    ht->nbatch_handlers++;
+  else if(ht->batch_handlers[entry->etid]!=NULL && handler==NULL)
+    ht->nbatch_handlers--;
+  ht->batch_handlers[entry->etid] = handler;
+  _cs_evm_htab_publish(evm, ht);
+  unlock_eh_tree(evm);
+  return 0;
+}
+
+int cs_evm_set_type_priority(cs_event_type_t etype, int priority, cs_event_manager_t *evm){
+  cs_event_handler_entry_t *entry;
+  cs_evm_htab_t *ht;
+  if(etype==NULL || strlen((const char *) etype)==0){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_set_type_priority(), parameter etype cannot be null or empty!");
+    return -1;
+  }
+  if(priority<CS_EVM_MIN_PRIORITY || priority>CS_EVM_MAX_PRIORITY){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_set_type_priority(), the priority %d of type %s is out of range", priority, etype);
+    return -1;
+  }
+
+  lock_eh_tree(evm);
+  if((entry = _cs_evm_type_entry(evm, etype, 1))==NULL || (ht = _cs_evm_htab_copy(evm))==NULL){
+    unlock_eh_tree(evm);
+    return -1;
+  }
+  ht->priorities[entry->etid] = (signed char) priority;
+  _cs_evm_htab_publish(evm, ht);
+  unlock_eh_tree(evm);
+  return 0;
+}
 
-  new_entry = (cs_event_handler_entry_t *) malloc(sizeof(cs_event_handler_entry_t));
-  new_entry->handler = handler;
-  new_entry->etype = etype;
+/*
+* Publish a new chain of subscribers of the type etype: the current one
+* with handler added (add set) at the given priority, or removed.
+*/
+int _cs_evm_update_chain(cs_event_manager_t *evm, cs_event_type_t etype, cs_event_handler_t handler, int priority, short int add){
+  cs_event_handler_entry_t *entry;
+  cs_evm_chain_t *old, *chain = NULL;
+  cs_evm_htab_t *ht;
+  int i, j, n, found = -1, placed = 0;
 
-  if(rb_find(evm->eh_tree, &search)!=NULL)
-    rb_replace(evm->eh_tree, handler);  
+  lock_eh_tree(evm);
+  if((entry = _cs_evm_type_entry(evm, etype, add))==NULL){
+    unlock_eh_tree(evm);
+    return -1;
+  }
+  old = evm->htab->chains[entry->etid];
+  n = (old!=NULL ? old->n : 0);
+  for(i=0; i<n && found<0; i++)
+    if(old->subs[i].handler==handler)
+      found = i;
+  if((add && found>=0) || (!add && found<0)){
+    unlock_eh_tree(evm);
+    return -1;
+  }
 
-  else
-    rb_insert(evm->eh_tree, new_entry);
+  if(n+(add ? 1 : -1)>0){
+    if(!(chain = (cs_evm_chain_t *) malloc(sizeof(cs_evm_chain_t)+(n+1)*sizeof(cs_evm_subscriber_t)))){
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error subscribing to the event type %s", etype);
+      unlock_eh_tree(evm);
+      return -1;
+    }
+    chain->subs = (cs_evm_subscriber_t *) (chain+1);
+    //the new subscriber goes after those of the same priority
+    for(i=0, j=0; i<n; i++){
+      if(i==found)
+	continue;
+      if(add && !placed && old->subs[i].priority>priority){
+	chain->subs[j].handler = handler;
+	chain->subs[j++].priority = priority;
+	placed = 1;
+      }
+      chain->subs[j++] = old->subs[i];
+    }
+    if(add && !placed){
+      chain->subs[j].handler = handler;
+      chain->subs[j++].priority = priority;
+    }
+    chain->n = j;
+    for(chain->split=0; chain->split<j && chain->subs[chain->split].priority<0; chain->split++);
+  }
 
+  if(!(ht = _cs_evm_htab_copy(evm))){
+    free(chain);
+    unlock_eh_tree(evm);
+    return -1;
+  }
+  ht->chains[entry->etid] = chain;
+  if(chain!=NULL){
+    chain->retired = evm->chains;
+    evm->chains = chain;
+  }
+  _cs_evm_htab_publish(evm, ht);
   unlock_eh_tree(evm);
   return 0;
 }
 
+int cs_evm_subscribe(cs_event_type_t etype, cs_event_handler_t handler, int priority, cs_event_manager_t *evm){
+  if(etype==NULL || strlen((const char *) etype)==0 || handler==NULL){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_subscribe(), invalid parameters");
+    return -1;
+  }
+  return _cs_evm_update_chain(evm, etype, handler, priority, 1);
+}
+
+int cs_evm_unsubscribe(cs_event_type_t etype, cs_event_handler_t handler, cs_event_manager_t *evm){
+  if(etype==NULL || handler==NULL)
+    return -1;
+  return _cs_evm_update_chain(evm, etype, handler, 0, 0);
+}
+
+cs_clockv cs_evm_now(cs_event_manager_t *evm){
+  if(_cs_evm_ctx!=NULL && _cs_evm_ctx->evm==evm)
+    return _cs_evm_ctx->ev_now;
+  return cs_get_clock(evm->timer);
+}
+
 /**
 * Throw the specified event, by the relative handler.
 **/
@@ -497,46 +1863,228 @@ cs_eh_status cs_evm_throw_event(cs_event_manager_t *evm, cs_event_t *ev)
 {
   assert(ev!=NULL);
   assert(ev->etype!=NULL);
-  cs_event_handler_t handler = cs_evm_get_handler(ev->etype, evm);
-  if(handler==NULL){
+  if((ev->etid = _cs_evm_resolve_type(evm, ev->etype, 0))<0){
     log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_throw_event(), no event handle for vent type %s", ev->etype);
     return CS_EH_NO_HANDLER;
   }
-  else
-    return (handler (ev, evm));
+  return _cs_evm_dispatch(evm, ev);
 }
 
-cs_event_list_t *pop_events(cs_event_manager_t *evm, cs_clockv time){
+/*
+* Move the periodic schedule p to the slot of its next occurrence.
+*/
+void _cs_evm_wheel_link(cs_evm_wheel_t *w, cs_evm_periodic_t *p){
+  cs_evm_periodic_t **slot = &w->slots[p->next % CS_EVM_WHEEL_SLOTS];
+  p->wnext = *slot;
+  *slot = p;
+}
 
-    cs_event_list_t search, *found = NULL;
-    search.scheduled_at = time;
+/*
+* A periodic schedule is over: it is released, along with 
+* the pending schedule of its event.
+*/
+void _cs_evm_wheel_drop(cs_event_manager_t *evm, cs_evm_periodic_t *p){
+  __atomic_store_n(&evm->wheel.n, evm->wheel.n-1, __ATOMIC_RELEASE);
+  _cs_evm_event_done(evm, p->ev);
+  free(p);
+}
 
-    //LOCK 
-    lock_ev_tree(evm);
-    found = rb_delete(evm->ev_tree, &search); //delete the entry from the tree
-    /*if(found!=NULL){
-      destroy_event_list(found, NULL); //destroy the list of events
-      free(found);
-    }*/
-    //UNLOCK
-    unlock_ev_tree(evm);
+/*
+* Raise the periodic events due at the time t, appending them to the 
+* list of the tick (a new one if list is NULL). The slots of the ticks 
+* skipped since the last call are visited too, thus the overdue 
+* occurrences are raised at t, once.
+* @return the list of the tick.
+*/
+cs_event_list_t *_cs_evm_wheel_fire(cs_event_manager_t *evm, cs_clockv t, cs_event_list_t *list){
+  cs_evm_wheel_t *w = &evm->wheel;
+  cs_evm_periodic_t *p, **prev, *due = NULL;
+  cs_clockv tick, first;
+
+  pthread_mutex_lock(w->lock);
+  if(t<=w->now){
+    pthread_mutex_unlock(w->lock);
+    return list;
+  }
+  first = (w->now<0 || t-w->now>=CS_EVM_WHEEL_SLOTS ? t-CS_EVM_WHEEL_SLOTS+1 : w->now+1);
+  w->now = t;
+
+  //unlink the due schedules
+  for(tick=first; tick<=t && w->n>0; tick++)
+    for(prev=&w->slots[((tick % CS_EVM_WHEEL_SLOTS)+CS_EVM_WHEEL_SLOTS) % CS_EVM_WHEEL_SLOTS]; (p = *prev)!=NULL; ){
+      if(p->next>t){
+	prev = &p->wnext;
+	continue;
+      }
+      *prev = p->wnext;
+      p->wnext = due;
+      due = p;
+    }
+
+  //raise them, and move them to their next slot
+  for(; (p = due)!=NULL; ){
+    due = p->wnext;
+    if((p->ev->flags & CS_EV_PERIODIC_STOP) || p->count==0){
+      _cs_evm_wheel_drop(evm, p);
+      continue;
+    }
+    if(list==NULL && (list = new_ev_list(t))==NULL){
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Periodic events at %li lost", (long int) t);
+      _cs_evm_wheel_link(w, p);
+      continue;
+    }
+    if(_cs_ev_list_push(list, p->ev)<0)
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Periodic event %s at %li lost", p->ev->etype, (long int) t);
+    else if(_cs_evm_is_pooled(evm, p->ev))
+      __sync_fetch_and_add(&p->ev->pending, 1);
+
+    p->next+=((t-p->next)/p->period+1)*p->period;
+    if(p->count>0 && --p->count==0)
+      _cs_evm_wheel_drop(evm, p);
+    else
+      _cs_evm_wheel_link(w, p);
+  }
+  pthread_mutex_unlock(w->lock);
+  return list;
+}
+
+/*
+* The time of the nearest periodic event, < 0 if none. The slots of 
+* a turn of the wheel are visited first, then all the schedules.
+*/
+cs_clockv _cs_evm_wheel_nearest(cs_event_manager_t *evm){
+  cs_evm_wheel_t *w = &evm->wheel;
+  cs_evm_periodic_t *p;
+  cs_clockv tick, nearest = -1;
+  int i;
+
+  if(__atomic_load_n(&w->n, __ATOMIC_ACQUIRE)==0)
+    return -1;
+  pthread_mutex_lock(w->lock);
+  for(tick=w->now+1; tick<=w->now+CS_EVM_WHEEL_SLOTS && nearest<0; tick++)
+    for(p=w->slots[tick % CS_EVM_WHEEL_SLOTS]; p!=NULL; p=p->wnext)
+      if(p->next<=tick && (nearest<0 || p->next<nearest))
+	nearest = p->next;
+  for(i=0; i<CS_EVM_WHEEL_SLOTS && nearest<0; i++)
+    for(p=w->slots[i]; p!=NULL; p=p->wnext)
+      if(nearest<0 || p->next<nearest)
+	nearest = p->next;
+  pthread_mutex_unlock(w->lock);
+  return nearest;
+}
+
+/*
+* The time of the farthest periodic event, i.e. of the latest next 
+* tick of the schedules, < 0 if none.
+*/
+cs_clockv _cs_evm_wheel_farthest(cs_event_manager_t *evm){
+  cs_evm_wheel_t *w = &evm->wheel;
+  cs_evm_periodic_t *p;
+  cs_clockv farthest = -1;
+  int i;
+
+  if(__atomic_load_n(&w->n, __ATOMIC_ACQUIRE)==0)
+    return -1;
+  pthread_mutex_lock(w->lock);
+  for(i=0; i<CS_EVM_WHEEL_SLOTS; i++)
+    for(p=w->slots[i]; p!=NULL; p=p->wnext)
+      if(p->next>farthest)
+	farthest = p->next;
+  pthread_mutex_unlock(w->lock);
+  return farthest;
+}
+
+int cs_evm_schedule_periodic(cs_event_t *ev, cs_clockv start, cs_clockv period, long int count, cs_event_manager_t *evm){
+  cs_evm_periodic_t *p;
+
+  if(ev->etype==NULL || period<1 || start<0 || count==0){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_schedule_periodic(), invalid parameters");
+    return -1;
+  }
+  if((ev->etid = _cs_evm_resolve_type(evm, ev->etype, 1))<0)
+    return -1;
+  if(!(p = (cs_evm_periodic_t *) malloc(sizeof(cs_evm_periodic_t)))){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error scheduling a periodic event");
+    return -1;
+  }
+  p->ev = ev;
+  p->period = period;
+  p->count = count;
+
+  pthread_mutex_lock(evm->wheel.lock);
+  ev->flags&=~CS_EV_PERIODIC_STOP;
+  //the ticks already raised are skipped
+  p->next = start;
+  if(start<=evm->wheel.now)
+    p->next+=((evm->wheel.now-start)/period+1)*period;
+  //the periodic schedule is a pending schedule of the event
+  if(_cs_evm_is_pooled(evm, ev))
+    __sync_fetch_and_add(&ev->pending, 1);
+  _cs_evm_wheel_link(&evm->wheel, p);
+  __atomic_store_n(&evm->wheel.n, evm->wheel.n+1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(evm->wheel.lock);
+  return 0;
+}
+
+void cs_evm_stop_periodic(cs_event_t *ev, cs_event_manager_t *evm){
+  pthread_mutex_lock(evm->wheel.lock);
+  ev->flags|=CS_EV_PERIODIC_STOP;
+  pthread_mutex_unlock(evm->wheel.lock);
+}
 
-    return found;
+/*
+* Release the periodic schedules, and the wheel.
+*/
+void _cs_evm_destroy_wheel(cs_event_manager_t *evm){
+  cs_evm_periodic_t *p, *next;
+  int i;
+  for(i=0; i<CS_EVM_WHEEL_SLOTS; i++)
+    for(p=evm->wheel.slots[i]; p!=NULL; p=next){
+      next = p->wnext;
+      free(p);
+    }
+  pthread_mutex_destroy(evm->wheel.lock);
+  free(evm->wheel.lock);
+}
+
+cs_event_list_t *pop_events(cs_event_manager_t *evm, cs_clockv time){
+
+    cs_event_list_t *found, *merged = NULL;
+    int i;
+
+    //delete the entry from each shard, merging the lists
+    for(i=0; i<evm->nshards; i++){
+      lock_shard(&evm->shards[i]);
+      if((found = cs_evstore_remove(evm->shards[i].store, time))!=NULL)
+	_cs_evm_shard_count(&evm->shards[i], -found->count);
+      unlock_shard(&evm->shards[i]);
+
+      if(found==NULL)
+	continue;
+      else if(merged==NULL)
+	merged = found;
+      else{
+	if(_cs_ev_list_append(merged, found)<0)
+	  _cs_evm_drop_events(evm, found, time);
+	destroy_event_list(found, NULL);
+      }
+    }
+
+    //the occurrences of the periodic events
+    return _cs_evm_wheel_fire(evm, time, merged);
 }
 
 void cs_evm_delete_events(cs_event_manager_t *evm, cs_clockv time){
-    cs_event_list_t search, *found;
-    search.scheduled_at = time;
+    cs_event_list_t *found;
+    int i;
 
-    //LOCK 
-    lock_ev_tree(evm);
-    found = rb_delete(evm->ev_tree, &search); //delete the entry from the tree
-    if(found!=NULL){
+    if((found = pop_events(evm, time))!=NULL){
+      for(i=0; i<found->count; i++){
+	_cs_evm_claim_event(evm, found->evs[i], time); //the handles get stale
+	_cs_evm_event_done(evm, found->evs[i]);
+      }
       destroy_event_list(found, NULL); //destroy the list of events
-      free(found);
     }
-    //UNLOCK
-    unlock_ev_tree(evm);
 }
 
 /**
@@ -545,30 +2093,25 @@ void cs_evm_delete_events(cs_event_manager_t *evm, cs_clockv time){
 int cs_evm_throw_scheduled_events(cs_event_manager_t * evm, cs_clockv time)
 {
   int c = 0;
-  cs_event_list_t *ev_list;
-  cs_event_list_item_t *cur;
+  cs_event_list_t *ev_list, buf;
 
-  //LOCK
-  lock_ev_tree(evm);
-  ev_list = get_events(evm, time);
+  ev_list = pop_events(evm, time);
   if(ev_list==NULL || ev_list->count==0){
-    unlock_ev_tree(evm);
+    destroy_event_list(ev_list, NULL);
     return c;
   }
 
-  else{
-    assert(ev_list->head!=NULL);
-    cur = ev_list->head;
-    do{
-      cs_evm_throw_event(evm, cur->ev);
-      c++;
-    }while((cur = cur->enext) != NULL);
+  if(evm->sort_ticks || __atomic_load_n(&evm->htab, __ATOMIC_ACQUIRE)->nbatch_handlers>0){
+    memset(&buf, 0, sizeof(cs_event_list_t));
+    if(evm->sort_ticks)
+      _cs_evm_sort_tick(evm, ev_list, &buf);
+    else
+      _cs_evm_group_by_type(evm, ev_list, &buf);
+    free(buf.evs);
   }
+  _cs_evm_dispatch_range(evm, ev_list->evs, 0, (c = ev_list->count), time);
 
-  cs_evm_delete_events(evm, time);
-  
-  //UNLOCK 
-  unlock_ev_tree(evm);
+  destroy_event_list(ev_list, NULL);
   return c;
 }
 
@@ -577,14 +2120,7 @@ int cs_evm_throw_scheduled_events(cs_event_manager_t * evm, cs_clockv time)
 **/
 int cs_evm_event_tree_is_empty(cs_event_manager_t * evm)
 {
-    int ret;
-    lock_ev_tree(evm);
-    if (evm->ev_tree->rb_count== 0)
-	ret = 1;
-    else
-	ret = 0;
-    unlock_ev_tree(evm);
-    return ret;
+    return (cs_evm_num_events(evm)==0);
 }
 
 int cs_evm_more_events(cs_event_manager_t *evm){
@@ -595,66 +2131,228 @@ int cs_evm_more_events(cs_event_manager_t *evm){
 * Return the number of events of the event tree.
 **/
 int cs_evm_num_events(cs_event_manager_t *evm){
-  int count = 0;
-  int c = 0;
-  cs_event_list_t *ev_list;
-  struct rb_traverser trav;
-  lock_ev_tree(evm);
-  count = rb_count(evm->ev_tree);
-  if(count==0){    
-    unlock_ev_tree(evm);
-    return 0;
-  }
-
-  rb_t_init(&trav, evm->ev_tree);
-  ev_list = rb_t_first(&trav, evm->ev_tree);
-  while(count>0 && ev_list!=NULL){
-    c+=ev_list->count;
-    count--;    
-  }
-  unlock_ev_tree(evm);
-  return c;
+  long int c = 0;
+  int i;
+  for(i=0; i<evm->nshards; i++)
+    c+=__atomic_load_n(&evm->shards[i].count, __ATOMIC_ACQUIRE);
+  c+=__atomic_load_n(&evm->wheel.n, __ATOMIC_ACQUIRE);
+  if(evm->spill!=NULL)
+    c+=__atomic_load_n(&evm->spill->n, __ATOMIC_ACQUIRE);
+  return (int) c;
 }
 
 /*
-* Schedule a new event by inserting it in the tree.
+* Schedule a new event by inserting it in the 
+* shard of the calling thread.
 */
-int cs_evm_schedule_event(cs_event_t *ev, cs_clockv at, cs_event_manager_t *evm)
+int _cs_evm_schedule(cs_event_t *ev, cs_clockv at, cs_event_manager_t *evm)
 {  
-    cs_event_list_t search, *found;
-    search.scheduled_at = at;
-    cs_event_list_item_t *new_item;
+    cs_event_manager_t *dest;
 
     if(ev->etype==NULL){
       log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Event has NULL event-type, doing nothing!");
       return -1;
     }
 
-    new_item = new_ev_list_item(ev);
+    //resolve the type now, so that dispatching is just an index
+    if((ev->etid = _cs_evm_resolve_type(evm, ev->etype, 1))<0)
+      return -1;
+
+    if(_cs_evm_stats_on(evm) && ev->etype!=_cs_evm_broadcast_type)
+      _cs_evstats_scheduled(evm, _cs_evm_task_index(evm), ev->etid);
+
+    //a pooled event is recycled when its last schedule is over
+    if(_cs_evm_is_pooled(evm, ev))
+      __sync_fetch_and_add(&ev->pending, 1);
 
-    //LOCK
-    lock_ev_tree(evm);
-    found = (cs_event_list_t *) rb_find(evm->ev_tree, &search);
-    if(found==NULL){
-      found = new_ev_list(at);
-      found->head = found->tail = new_item;
-      rb_insert(evm->ev_tree, found);
+    //from a handler which does not schedule directly
+    if(_cs_evm_ctx!=NULL && _cs_evm_ctx->evm==evm && _cs_evm_ctx->send!=NULL){
+      if(_cs_evm_ctx->send(ev, at, _cs_evm_ctx->send_arg, evm)==0)
+	return 0;
+      if(_cs_evm_is_pooled(evm, ev))
+	__sync_fetch_and_sub(&ev->pending, 1);
+      return -1;
     }
 
-    else{
-      found->tail->enext = new_item;
-      new_item->enext = NULL;
-      found->tail = new_item;      
-    }    
+    //the events of a target of another member of the group
+    if(evm->group!=NULL && ev->target>=0 && (dest = cs_evm_group_member(evm->group, ev->target))!=evm){
+      if(_cs_evgroup_send(evm, dest, ev, at)==0)
+	return 0;
+      if(_cs_evm_is_pooled(evm, ev))
+	__sync_fetch_and_sub(&ev->pending, 1);
+      return -1;
+    }
 
-    found->count++;
-    
-    //UNLOCK
-    unlock_ev_tree(evm);
+    //far-future events go to the spill file
+    if(evm->spill!=NULL && _cs_spill_event(evm, ev, at)==0)
+      return 0;
+
+    //from a handler, for the current tick: the next delta cycle
+    if(_cs_evm_ctx!=NULL && _cs_evm_ctx->evm==evm && at==_cs_evm_ctx->now && evm->lookahead==1 &&
+	_cs_ev_list_push(&evm->wbufs[_cs_evm_ctx->index].delta, ev)==0)
+      return 0;
 
+    //from a handler, for a next tick: no need to lock
+    if(_cs_evm_ctx!=NULL && _cs_evm_ctx->evm==evm && at>_cs_evm_ctx->now &&
+	_cs_evm_wbuf_append(&evm->wbufs[_cs_evm_ctx->index], ev, at)==0)
+      return 0;
+
+    if(_cs_evm_store_event(evm, ev, at)<0){
+      if(_cs_evm_is_pooled(evm, ev))
+	__sync_fetch_and_sub(&ev->pending, 1);
+      return -1;
+    }
     return 0;
 }
 
+int cs_evm_schedule_event(cs_event_t *ev, cs_clockv at, cs_event_manager_t *evm){
+  if(_cs_evm_is_pooled(evm, ev) && (ev->flags & CS_EV_HANDLED)){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_schedule_event(), event %s is scheduled by handle", ev->etype);
+    return -1;
+  }
+  return _cs_evm_schedule(ev, at, evm);
+}
+
+int cs_evm_schedule_event_handle(cs_event_t *ev, cs_clockv at, cs_event_manager_t *evm, cs_ev_handle_t *h){
+  if(!_cs_evm_is_pooled(evm, ev) || evm->tw!=NULL){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_schedule_event_handle(), only pooled events, and not in optimistic mode");
+    return -1;
+  }
+  //a single live schedule by handle
+  if(!__sync_bool_compare_and_swap(&ev->sched_at, -1, at)){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_schedule_event_handle(), event %s already scheduled at %li", ev->etype, (long int) ev->sched_at);
+    return -1;
+  }
+  ev->flags |= CS_EV_HANDLED;
+  h->ev = ev;
+  h->at = at;
+  //the generation is odd while the schedule is live
+  h->gen = __sync_add_and_fetch(&ev->gen, 1);
+  if(_cs_evm_schedule(ev, at, evm)<0){
+    __sync_fetch_and_add(&ev->gen, 1);
+    __atomic_store_n(&ev->sched_at, -1, __ATOMIC_RELEASE);
+    return -1;
+  }
+  return 0;
+}
+
+int cs_evm_cancel(cs_ev_handle_t *h, cs_event_manager_t *evm){
+  cs_event_t *ev = h->ev;
+  //a single step: the generation changes once the schedule is raised or
+  //cancelled, and a new schedule (even at the same time) has a new one
+  if(ev==NULL || !(h->gen & 1) || !__sync_bool_compare_and_swap(&ev->gen, h->gen, h->gen+1))
+    return -1;
+  //the entry in the event set is now a tombstone
+  __atomic_store_n(&ev->sched_at, -1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+int cs_evm_reschedule(cs_ev_handle_t *h, cs_clockv at, cs_event_manager_t *evm){
+  cs_event_t *ev = h->ev;
+  int pending, ret;
+  if(ev==NULL)
+    return -1;
+  if(at==h->at)
+    return (__atomic_load_n(&ev->gen, __ATOMIC_ACQUIRE)==h->gen && __atomic_load_n(&ev->sched_at, __ATOMIC_ACQUIRE)==at ? 0 : -1);
+  //hold the event: once cancelled, the tombstone may be dispatched and 
+  //drop its reference before the new schedule takes one
+  do{
+    if((pending = __atomic_load_n(&ev->pending, __ATOMIC_ACQUIRE))==0)
+      return -1; //back to the pool, the schedule is over
+  }while(!__sync_bool_compare_and_swap(&ev->pending, pending, pending+1));
+  if(cs_evm_cancel(h, evm)<0)
+    ret = -1;
+  else
+    ret = cs_evm_schedule_event_handle(ev, at, evm, h);
+  _cs_evm_event_done(evm, ev);
+  return ret;
+}
+
+/*
+* The payload of the events carrying a broadcast: the event, 
+* followed by the targets.
+*/
+typedef struct _cs_evm_bcast_s{
+  cs_event_t *ev;
+  int ntargets;
+}_cs_evm_bcast_t;
+
+/*
+* The handler of the events carrying a broadcast: it delivers
+* the event to each target in turn.
+*/
+cs_eh_status _cs_evm_broadcast(cs_event_t *carrier, cs_event_manager_t *evm){
+  _cs_evm_bcast_t *b = (_cs_evm_bcast_t *) carrier->ev_data;
+  long int *targets = (long int *) (b+1), prev_target = _cs_evm_bcast_target;
+  cs_event_t *prev_ev = _cs_evm_bcast_ev;
+  int i;
+
+  for(i=0; i<b->ntargets; i++){
+    _cs_evm_bcast_ev = b->ev;
+    _cs_evm_bcast_target = targets[i];
+    _cs_evm_dispatch(evm, b->ev);
+  }
+  _cs_evm_bcast_ev = prev_ev;
+  _cs_evm_bcast_target = prev_target;
+  _cs_evm_event_done(evm, b->ev);
+  return CS_EH_NORMAL;
+}
+
+int cs_evm_schedule_broadcast(cs_event_t *ev, cs_clockv at, const long int *targets, int ntargets, cs_event_manager_t *evm){
+  _cs_evm_bcast_t *b;
+  cs_event_t *carrier;
+
+  if(ev==NULL || ev->etype==NULL || ntargets<1 || targets==NULL || evm->tw!=NULL){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_schedule_broadcast(), invalid parameters");
+    return -1;
+  }
+  if(cs_evm_get_handler(_cs_evm_broadcast_type, evm)==NULL &&
+     cs_evm_install_handler(_cs_evm_broadcast_type, _cs_evm_broadcast, evm)<0)
+    return -1;
+  if((ev->etid = _cs_evm_resolve_type(evm, ev->etype, 1))<0)
+    return -1;
+  if(!(carrier = cs_evm_alloc_event_data(_cs_evm_broadcast_type, NULL, sizeof(_cs_evm_bcast_t)+ntargets*sizeof(long int), evm)))
+    return -1;
+  b = (_cs_evm_bcast_t *) carrier->ev_data;
+  b->ev = ev;
+  b->ntargets = ntargets;
+  memcpy(b+1, targets, ntargets*sizeof(long int));
+
+  //the event is pending until the last delivery
+  if(_cs_evm_is_pooled(evm, ev))
+    __sync_fetch_and_add(&ev->pending, 1);
+  if(_cs_evm_schedule(carrier, at, evm)<0){
+    if(_cs_evm_is_pooled(evm, ev))
+      __sync_fetch_and_sub(&ev->pending, 1);
+    cs_evm_free_event(carrier, evm);
+    return -1;
+  }
+  return 0;
+}
+
+long int cs_ev_target(cs_event_t *ev){
+  return (ev==_cs_evm_bcast_ev ? _cs_evm_bcast_target : ev->target);
+}
+
+void cs_ev_init(cs_event_t *ev){
+  memset(ev, 0, sizeof(cs_event_t));
+  ev->etid = -1;
+  ev->target = -1;
+  ev->sched_at = -1;
+}
+
+cs_event_t *cs_new_events(int n){
+  cs_event_t *evs;
+  int i;
+  if(n<1 || !(evs = (cs_event_t *) malloc(n*sizeof(cs_event_t)))){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error allocating %d events", n);
+    return NULL;
+  }
+  for(i=0; i<n; i++)
+    cs_ev_init(&evs[i]);
+  return evs;
+}
+
 
 /**
 * Look for the event with the minimum
@@ -663,20 +2361,24 @@ int cs_evm_schedule_event(cs_event_t *ev, cs_clockv at, cs_event_manager_t *evm)
 cs_clockv cs_evm_find_nearest_events(cs_event_manager_t * evm)
 {
   cs_event_list_t *found;
-  struct rb_traverser trav;
-  rb_t_init(&trav, evm->ev_tree);
+  cs_clockv nearest = -1, next;
+  int i;
 
-  //LOCK 
-  lock_ev_tree(evm);
-  found = (cs_event_list_t *) rb_t_first(&trav, evm->ev_tree);
-  //UNLOCK
-  unlock_ev_tree(evm);
-
-  if(found!=NULL && found->count>0)
-    return found->scheduled_at;
+  for(i=0; i<evm->nshards; i++){
+    //LOCK 
+    lock_shard(&evm->shards[i]);
+    found = cs_evstore_first(evm->shards[i].store);
+    if(found!=NULL && found->count>0 && (nearest<0 || found->scheduled_at<nearest))
+      nearest = found->scheduled_at;
+    //UNLOCK
+    unlock_shard(&evm->shards[i]);
+  }
 
-  else
-    return -1;
+  if((next = _cs_evm_wheel_nearest(evm))>=0 && (nearest<0 || next<nearest))
+    nearest = next;
+  if((next = _cs_spill_nearest(evm))>=0 && (nearest<0 || next<nearest))
+    nearest = next;
+  return nearest;
 }
 
 /**
@@ -686,15 +2388,20 @@ cs_clockv cs_evm_find_nearest_events(cs_event_manager_t * evm)
 cs_clockv cs_evm_find_farthest_events(cs_event_manager_t *evm)
 {
   cs_event_list_t *found;
-  struct rb_traverser trav;
-  rb_t_init(&trav, evm->ev_tree);
-
-  lock_ev_tree(evm);
-  found = (cs_event_list_t *) rb_t_last(&trav, evm->ev_tree);
-  unlock_ev_tree(evm);
-
-  if(found!=NULL && found->count>0)
-    return found->scheduled_at;
+  cs_clockv farthest = -1, next;
+  int i;
+
+  for(i=0; i<evm->nshards; i++){
+    lock_shard(&evm->shards[i]);
+    found = cs_evstore_last(evm->shards[i].store);
+    if(found!=NULL && found->count>0 && found->scheduled_at>farthest)
+      farthest = found->scheduled_at;
+    unlock_shard(&evm->shards[i]);
+  }
 
-  return -1;
+  if((next = _cs_evm_wheel_farthest(evm))>farthest)
+    farthest = next;
+  if((next = _cs_spill_farthest(evm))>farthest)
+    farthest = next;
+  return farthest;
 }
@@ -0,0 +1,168 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "complex_sim.h"
+#include "cs_evgroup.h"
+
+int _cs_evgroup_modulo(long int target, int nmembers){
+  return (int) (target % nmembers);
+}
+
+int cs_evm_group_init(cs_evm_group_t *group, int nmembers, int nworkers, cs_timer_t *timer, sim_type_t type, const cs_evm_conf_t *conf){
+  cs_event_manager_t *evm;
+  int i;
+
+  if(group==NULL || nmembers<1 || (conf!=NULL && conf->lookahead>1)){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_group_init(), invalid parameters");
+    return -1;
+  }
+  if(!(group->members = (cs_event_manager_t *) calloc(nmembers, sizeof(cs_event_manager_t)))){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_FATAL, "Memory error allocating the event managers of a group");
+    return -1;
+  }
+  group->nmembers = 0;
+  group->route = _cs_evgroup_modulo;
+
+  for(i=0; i<nmembers; i++){
+    evm = &group->members[i];
+    if(cs_init_event_manager_conf(evm, nworkers, timer, type, conf)<0){
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_FATAL, "Impossible to initiate the event manager %d of a group", i);
+      cs_evm_group_destroy(group);
+      return -1;
+    }
+    //not yet a member: destroyed apart
+    if(!(evm->outboxes = (cs_evm_wbuf_t *) calloc(evm->nwbufs*nmembers, sizeof(cs_evm_wbuf_t)))){
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_FATAL, "Memory error allocating the outboxes of the event manager %d of a group", i);
+      cs_destroy_event_manager(evm);
+      cs_evm_group_destroy(group);
+      return -1;
+    }
+    evm->group = group;
+    evm->member = i;
+    group->nmembers++;
+  }
+  return 0;
+}
+
+void cs_evm_group_destroy(cs_evm_group_t *group){
+  int i;
+  for(i=0; i<group->nmembers; i++)
+    cs_destroy_event_manager(&group->members[i]);
+  free(group->members);
+  group->members = NULL;
+  group->nmembers = 0;
+}
+
+void cs_evm_group_set_route(cs_evm_group_t *group, cs_evm_group_route_t route){
+  group->route = (route!=NULL ? route : _cs_evgroup_modulo);
+}
+
+cs_event_manager_t *cs_evm_group_member(cs_evm_group_t *group, long int target){
+  int m = (target>=0 ? group->route(target, group->nmembers) : 0);
+  assert(m>=0 && m<group->nmembers);
+  return &group->members[m];
+}
+
+int cs_evm_group_install_handler(cs_evm_group_t *group, cs_event_type_t etype, cs_event_handler_t handler){
+  int i;
+  for(i=0; i<group->nmembers; i++)
+    if(cs_evm_install_handler(etype, handler, &group->members[i])<0)
+      return -1;
+  return 0;
+}
+
+int cs_evm_group_bind(cs_evm_group_t *group, int member, const int *cpus, int ncpus){
+  if(member<0 || member>=group->nmembers)
+    return -1;
+  return cs_wp_set_cpus(group->members[member].wp, cpus, ncpus);
+}
+
+int cs_evm_group_start(cs_evm_group_t *group, cs_clockv start_raising){
+  int i;
+  for(i=0; i<group->nmembers; i++)
+    if(cs_evm_start_controller(&group->members[i], start_raising)<0)
+      return -1;
+  return 0;
+}
+
+void cs_evm_group_stop(cs_evm_group_t *group){
+  int i;
+  for(i=0; i<group->nmembers; i++)
+    cs_evm_stop_controller(&group->members[i]);
+}
+
+int cs_evm_group_num_events(cs_evm_group_t *group){
+  int i, n = 0;
+  for(i=0; i<group->nmembers; i++)
+    n+=cs_evm_num_events(&group->members[i]);
+  return n;
+}
+
+cs_clockv cs_evm_group_find_nearest_events(cs_evm_group_t *group){
+  cs_clockv next = -1, t;
+  int i;
+  for(i=0; i<group->nmembers; i++)
+    if((t = cs_evm_find_nearest_events(&group->members[i]))>=0 && (next<0 || t<next))
+      next = t;
+  return next;
+}
+
+void cs_evm_group_wait_completion(cs_evm_group_t *group, cs_clockv clock){
+  int i;
+  for(i=0; i<group->nmembers; i++)
+    wait_event_completion(&group->members[i], clock);
+}
+
+int _cs_evgroup_send(cs_event_manager_t *evm, cs_event_manager_t *dest, cs_event_t *ev, cs_clockv at){
+  int index = _cs_evm_task_index(evm);
+
+  //the ids of the types are not shared by the members
+  if((ev->etid = _cs_evm_resolve_type(dest, ev->etype, 1))<0)
+    return -1;
+
+  //from outside the handlers: straight into the member
+  if(index<0)
+    return _cs_evm_store_event(dest, ev, at);
+
+  //the other member may be done with the current tick
+  if(at<=cs_evm_now(evm)){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "An event for the member %d of the group must be scheduled from the next tick on", dest->member);
+    return -1;
+  }
+  if(_cs_evm_wbuf_append(&evm->outboxes[index*evm->group->nmembers+dest->member], ev, at)==0)
+    return 0;
+  return _cs_evm_store_event(dest, ev, at);
+}
+
+cs_clockv _cs_evgroup_flush(cs_event_manager_t *evm){
+  cs_evm_group_t *group = evm->group;
+  cs_event_manager_t *dest;
+  cs_evm_wbuf_t *buf;
+  cs_clockv next = -1;
+  int i, m, r;
+
+  for(i=0; i<evm->nwbufs; i++)
+    for(m=0; m<group->nmembers; m++){
+      buf = &evm->outboxes[i*group->nmembers+m];
+      if(buf->nruns==0)
+	continue;
+      for(r=0; r<buf->nruns; r++)
+	if(next<0 || buf->runs[r].scheduled_at<next)
+	  next = buf->runs[r].scheduled_at;
+      dest = &group->members[m];
+      _cs_evm_merge_wbuf(dest, buf, &dest->shards[i % dest->nshards]);
+    }
+  return next;
+}
@@ -0,0 +1,167 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "complex_sim.h"
+#include "cs_evstats.h"
+
+int cs_evm_enable_type_stats(cs_event_manager_t *evm, short int enable){
+  cs_evstats_t *st;
+
+  pthread_mutex_lock(evm->mutex);
+  //the counters are kept until the event manager is destroyed,
+  //since the workers may be updating them
+  if(enable && evm->evstats==NULL){
+    if(!(st = (cs_evstats_t *) calloc(1, sizeof(cs_evstats_t))) ||
+       !(st->rows = (cs_evm_type_stats_t *) calloc((evm->nwbufs+1)*CS_EVM_MAX_TYPES, sizeof(cs_evm_type_stats_t))) ||
+       !(st->last_row_ns = (unsigned long long *) calloc(evm->nwbufs+1, sizeof(unsigned long long)))){
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Unable to alloc the counters of the event types");
+      if(st!=NULL){
+	free(st->rows);
+	free(st);
+      }
+      pthread_mutex_unlock(evm->mutex);
+      return -1;
+    }
+    st->nrows = evm->nwbufs+1;
+    pthread_mutex_init(&st->lock, NULL);
+    __atomic_store_n(&evm->evstats, st, __ATOMIC_RELEASE);
+  }
+  if(evm->evstats!=NULL)
+    __atomic_store_n(&evm->evstats->on, (enable ? 1 : 0), __ATOMIC_RELEASE);
+  pthread_mutex_unlock(evm->mutex);
+  return 0;
+}
+
+/*
+* The row of the task index, or the shared one.
+*/
+cs_evm_type_stats_t *_cs_evstats_row(cs_evstats_t *st, int index){
+  if(index<0 || index>=st->nrows-1)
+    index = st->nrows-1;
+  return st->rows+index*CS_EVM_MAX_TYPES;
+}
+
+void _cs_evstats_handled(cs_event_manager_t *evm, int index, int etid, int n, unsigned long long ns){
+  cs_evstats_t *st = evm->evstats;
+  cs_evm_type_stats_t *s = _cs_evstats_row(st, index)+etid;
+  short int shared = (s>=st->rows+(st->nrows-1)*CS_EVM_MAX_TYPES);
+
+  if(shared)
+    pthread_mutex_lock(&st->lock);
+  s->thrown+=n;
+  s->handler_ns+=ns;
+  cs_log_hist_add(&s->latency, ns);
+  if(shared)
+    pthread_mutex_unlock(&st->lock);
+}
+
+void _cs_evstats_scheduled(cs_event_manager_t *evm, int index, int etid){
+  cs_evstats_t *st = evm->evstats;
+  cs_evm_type_stats_t *s = _cs_evstats_row(st, index)+etid;
+
+  if(s>=st->rows+(st->nrows-1)*CS_EVM_MAX_TYPES)
+    __sync_fetch_and_add(&s->scheduled, 1);
+  else
+    s->scheduled++;
+}
+
+int cs_evm_type_stats(cs_event_manager_t *evm, cs_event_type_t etype, cs_evm_type_stats_t *snapshot){
+  cs_evstats_t *st = __atomic_load_n(&evm->evstats, __ATOMIC_ACQUIRE);
+  cs_evm_type_stats_t *s;
+  int etid, r;
+
+  if(st==NULL || !st->on || (etid = _cs_evm_resolve_type(evm, etype, 0))<0)
+    return -1;
+  memset(snapshot, 0, sizeof(cs_evm_type_stats_t));
+  pthread_mutex_lock(&st->lock);
+  for(r=0; r<st->nrows; r++){
+    s = st->rows+r*CS_EVM_MAX_TYPES+etid;
+    snapshot->thrown+=s->thrown;
+    snapshot->scheduled+=s->scheduled;
+    snapshot->handler_ns+=s->handler_ns;
+    cs_log_hist_merge(&snapshot->latency, &s->latency);
+  }
+  pthread_mutex_unlock(&st->lock);
+  return 0;
+}
+
+void cs_evm_reset_type_stats(cs_event_manager_t *evm){
+  cs_evstats_t *st = evm->evstats;
+  if(st==NULL)
+    return;
+  pthread_mutex_lock(&st->lock);
+  memset(st->rows, 0, st->nrows*CS_EVM_MAX_TYPES*sizeof(cs_evm_type_stats_t));
+  memset(st->last_thrown, 0, sizeof(st->last_thrown));
+  memset(st->last_scheduled, 0, sizeof(st->last_scheduled));
+  memset(st->last_type_ns, 0, sizeof(st->last_type_ns));
+  memset(st->last_row_ns, 0, st->nrows*sizeof(unsigned long long));
+  pthread_mutex_unlock(&st->lock);
+}
+
+void _cs_evstats_dump(cs_event_manager_t *evm, cs_clockv at){
+  const log4c_category_t *cat = log4c_category_get("cs.events.stats");
+  cs_evstats_t *st = evm->evstats;
+  cs_evm_type_stats_t *s;
+  unsigned long thrown, scheduled;
+  unsigned long long ns, row_ns, total = 0, max = 0;
+  int ntypes = __atomic_load_n(&evm->ntypes, __ATOMIC_ACQUIRE), r, t;
+
+  if(st==NULL || !st->on || !log4c_category_is_priority_enabled(cat, LOG4C_PRIORITY_DEBUG))
+    return;
+
+  pthread_mutex_lock(&st->lock);
+  for(t=0; t<ntypes; t++){
+    thrown = scheduled = 0;
+    ns = 0;
+    for(r=0; r<st->nrows; r++){
+      s = st->rows+r*CS_EVM_MAX_TYPES+t;
+      thrown+=s->thrown;
+      scheduled+=s->scheduled;
+      ns+=s->handler_ns;
+    }
+    if(thrown!=st->last_thrown[t] || scheduled!=st->last_scheduled[t])
+      log4c_category_log(cat, LOG4C_PRIORITY_DEBUG, "(t=%li) type %s: thrown %lu, scheduled %lu, handlers %llu ns", 
+			 (long int) at, evm->type_names[t], thrown-st->last_thrown[t], scheduled-st->last_scheduled[t], ns-st->last_type_ns[t]);
+    st->last_thrown[t] = thrown;
+    st->last_scheduled[t] = scheduled;
+    st->last_type_ns[t] = ns;
+  }
+
+  //the load of the tasks, the shared row aside
+  for(r=0; r<st->nrows; r++){
+    for(t=0, row_ns=0; t<ntypes; t++)
+      row_ns+=st->rows[r*CS_EVM_MAX_TYPES+t].handler_ns;
+    ns = row_ns-st->last_row_ns[r];
+    st->last_row_ns[r] = row_ns;
+    if(r<st->nrows-1){
+      total+=ns;
+      max = MAX(max, ns);
+    }
+  }
+  pthread_mutex_unlock(&st->lock);
+  if(total>0)
+    log4c_category_log(cat, LOG4C_PRIORITY_DEBUG, "(t=%li) tasks: handlers %llu ns, slowest task %llu ns, imbalance %.2f", 
+		       (long int) at, total, max, (double) max*(st->nrows-1)/total);
+}
+
+void _cs_evstats_destroy(cs_event_manager_t *evm){
+  cs_evstats_t *st = evm->evstats;
+  if(st==NULL)
+    return;
+  pthread_mutex_destroy(&st->lock);
+  free(st->rows);
+  free(st->last_row_ns);
+  free(st);
+  evm->evstats = NULL;
+}
@@ -0,0 +1,390 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "complex_sim.h"
+#include "cs_events.h"
+#include "cs_evstore.h"
+#include "rb.h"
+
+/* minimum number of buckets of a calendar queue */
+#define CAL_MIN_BUCKETS 16
+/* number of lists sampled to compute the width of the buckets */
+#define CAL_SAMPLES 25
+
+/*
+* Red-black tree store.
+*/
+
+int cmp_event_list(const void *t1, const void *t2, void *param){
+  const cs_event_list_t* el1 = t1;
+  const cs_event_list_t* el2 = t2;
+  if(t1==NULL || t2==NULL)
+    return -1;
+  return (el1->scheduled_at > el2->scheduled_at ? 1 : (el1->scheduled_at < el2->scheduled_at ? -1 : 0));
+}
+
+cs_event_list_t *_rbs_find(void *impl, cs_clockv at){
+  cs_event_list_t search;
+  search.scheduled_at = at;
+  return (cs_event_list_t *) rb_find((struct rb_table *) impl, &search);
+}
+
+int _rbs_insert(void *impl, cs_event_list_t *list){
+  return (rb_insert((struct rb_table *) impl, list) == NULL ? 0 : -1);
+}
+
+cs_event_list_t *_rbs_remove(void *impl, cs_clockv at){
+  cs_event_list_t search;
+  search.scheduled_at = at;
+  return (cs_event_list_t *) rb_delete((struct rb_table *) impl, &search);
+}
+
+cs_event_list_t *_rbs_first(void *impl){
+  struct rb_traverser trav;
+  return (cs_event_list_t *) rb_t_first(&trav, (struct rb_table *) impl);
+}
+
+cs_event_list_t *_rbs_last(void *impl){
+  struct rb_traverser trav;
+  return (cs_event_list_t *) rb_t_last(&trav, (struct rb_table *) impl);
+}
+
+int _rbs_count(void *impl){
+  return rb_count((struct rb_table *) impl);
+}
+
+void _rbs_walk(void *impl, void (*func) (cs_event_list_t *list, void *param), void *param){
+  struct rb_traverser trav;
+  cs_event_list_t *list;
+  for(list = rb_t_first(&trav, (struct rb_table *) impl); list!=NULL; list = rb_t_next(&trav))
+    func(list, param);
+}
+
+void _rbs_destroy(void *impl, void (*func) (void *item, void *param)){
+  rb_destroy((struct rb_table *) impl, func);
+}
+
+const cs_evstore_ops_t _cs_rbtree_ops = {
+  _rbs_find, _rbs_insert, _rbs_remove, _rbs_first, _rbs_last, _rbs_count, _rbs_walk, _rbs_destroy
+};
+
+/*
+* Calendar queue store (R. Brown, 1988). The lists are hashed into 
+* nbuckets buckets of width time units, each bucket being a list sorted 
+* by scheduling time and linked through the cnext field of the event 
+* lists (no allocation per element). The number of buckets follows the 
+* number of lists, while the width follows the average distance between 
+* the nearest scheduling times, which are sampled at each resize.
+*/
+typedef struct cs_calendar_s{
+  cs_event_list_t **buckets;
+  int nbuckets; //power of two
+  cs_clockv width;
+  int count;
+  /* the bucket where the last minimum has been found, and its upper bound */
+  int cur_bucket;
+  cs_clockv cur_top;
+}cs_calendar_t;
+
+int _cal_bucket(cs_calendar_t *cal, cs_clockv at){
+  return (int) ((at/cal->width) & (cal->nbuckets-1));
+}
+
+/*
+* Move the starting point of the search of 
+* the minimum to the bucket of the time at.
+*/
+void _cal_set_cursor(cs_calendar_t *cal, cs_clockv at){
+  cal->cur_bucket = _cal_bucket(cal, at);
+  cal->cur_top = (at/cal->width+1)*cal->width;
+}
+
+/*
+* Sorted insertion into the bucket.
+*/
+void _cal_link(cs_calendar_t *cal, cs_event_list_t *list){
+  cs_event_list_t **pos = &cal->buckets[_cal_bucket(cal, list->scheduled_at)];
+  while(*pos!=NULL && (*pos)->scheduled_at<list->scheduled_at)
+    pos = &(*pos)->cnext;
+  list->cnext = *pos;
+  *pos = list;
+}
+
+/*
+* Width of the buckets, estimated as three times the average separation
+* between the nearest scheduling times, ignoring the separations 
+* greater than twice the average.
+*/
+cs_clockv _cal_new_width(cs_event_list_t **lists, int n, cs_clockv old_width){
+  cs_clockv sample[CAL_SAMPLES];
+  cs_clockv tmp, sep, tot;
+  int ns = 0, i, j, nsep;
+
+  if(n<2)
+    return old_width;
+
+  /* keep the CAL_SAMPLES minimum times, in order */
+  for(i=0; i<n; i++){
+    tmp = lists[i]->scheduled_at;
+    if(ns==CAL_SAMPLES && tmp>=sample[ns-1])
+      continue;
+    j = (ns<CAL_SAMPLES ? ns++ : ns-1);
+    while(j>0 && sample[j-1]>tmp){
+      sample[j] = sample[j-1];
+      j--;
+    }
+    sample[j] = tmp;
+  }
+
+  tot = sample[ns-1]-sample[0];
+  for(i=1, sep=0, nsep=0; i<ns; i++)
+    if((sample[i]-sample[i-1])*(ns-1)<=2*tot){
+      sep+=sample[i]-sample[i-1];
+      nsep++;
+    }
+
+  if(nsep==0 || sep==0)
+    return 1;
+  return MAX(1, 3*sep/nsep);
+}
+
+/*
+* Rebuild the calendar with nbuckets buckets, 
+* recomputing the width of the buckets.
+*/
+int _cal_resize(cs_calendar_t *cal, int nbuckets){
+  cs_event_list_t **lists, **buckets, *list;
+  cs_clockv min = 0;
+  int i, n = 0;
+
+  if(!(lists = (cs_event_list_t **) malloc(sizeof(cs_event_list_t *)*MAX(1,cal->count))))
+    return -1;
+  if(!(buckets = (cs_event_list_t **) calloc(nbuckets, sizeof(cs_event_list_t *)))){
+    free(lists);
+    return -1;
+  }
+
+  for(i=0; i<cal->nbuckets; i++)
+    for(list = cal->buckets[i]; list!=NULL; list = list->cnext)
+      lists[n++] = list;
+  assert(n==cal->count);
+
+  free(cal->buckets);
+  cal->buckets = buckets;
+  cal->nbuckets = nbuckets;
+  cal->width = _cal_new_width(lists, n, cal->width);
+
+  for(i=0; i<n; i++){
+    if(i==0 || lists[i]->scheduled_at<min)
+      min = lists[i]->scheduled_at;
+    _cal_link(cal, lists[i]);
+  }
+  _cal_set_cursor(cal, min);
+
+  free(lists);
+  return 0;
+}
+
+cs_event_list_t *_cal_find(void *impl, cs_clockv at){
+  cs_calendar_t *cal = impl;
+  cs_event_list_t *list = cal->buckets[_cal_bucket(cal, at)];
+  while(list!=NULL && list->scheduled_at<at)
+    list = list->cnext;
+  return (list!=NULL && list->scheduled_at==at ? list : NULL);
+}
+
+int _cal_insert(void *impl, cs_event_list_t *list){
+  cs_calendar_t *cal = impl;
+
+  if(cal->count==0 || list->scheduled_at<cal->cur_top-cal->width)
+    _cal_set_cursor(cal, list->scheduled_at);
+
+  _cal_link(cal, list);
+  cal->count++;
+
+  if(cal->count>2*cal->nbuckets)
+    return _cal_resize(cal, 2*cal->nbuckets);
+  return 0;
+}
+
+cs_event_list_t *_cal_remove(void *impl, cs_clockv at){
+  cs_calendar_t *cal = impl;
+  cs_event_list_t **pos = &cal->buckets[_cal_bucket(cal, at)];
+  cs_event_list_t *found;
+
+  while(*pos!=NULL && (*pos)->scheduled_at<at)
+    pos = &(*pos)->cnext;
+  if(*pos==NULL || (*pos)->scheduled_at!=at)
+    return NULL;
+
+  found = *pos;
+  *pos = found->cnext;
+  found->cnext = NULL;
+  cal->count--;
+
+  if(cal->nbuckets>CAL_MIN_BUCKETS && cal->count<cal->nbuckets/2)
+    _cal_resize(cal, cal->nbuckets/2);
+  return found;
+}
+
+cs_event_list_t *_cal_first(void *impl){
+  cs_calendar_t *cal = impl;
+  cs_event_list_t *list, *min = NULL;
+  cs_clockv top = cal->cur_top;
+  int i = cal->cur_bucket;
+  int n;
+
+  if(cal->count==0)
+    return NULL;
+
+  /* scan one year starting from the last minimum */
+  for(n=0; n<cal->nbuckets; n++){
+    list = cal->buckets[i];
+    if(list!=NULL && list->scheduled_at<top){
+      cal->cur_bucket = i;
+      cal->cur_top = top;
+      return list;
+    }
+    i = (i+1) & (cal->nbuckets-1);
+    top+=cal->width;
+  }
+
+  /* nothing in this year, direct search */
+  for(i=0; i<cal->nbuckets; i++)
+    if(cal->buckets[i]!=NULL && (min==NULL || cal->buckets[i]->scheduled_at<min->scheduled_at))
+      min = cal->buckets[i];
+  _cal_set_cursor(cal, min->scheduled_at);
+  return min;
+}
+
+cs_event_list_t *_cal_last(void *impl){
+  cs_calendar_t *cal = impl;
+  cs_event_list_t *list, *max = NULL;
+  int i;
+  for(i=0; i<cal->nbuckets; i++)
+    for(list = cal->buckets[i]; list!=NULL; list = list->cnext)
+      if(max==NULL || list->scheduled_at>max->scheduled_at)
+	max = list;
+  return max;
+}
+
+int _cal_count(void *impl){
+  return ((cs_calendar_t *) impl)->count;
+}
+
+void _cal_walk(void *impl, void (*func) (cs_event_list_t *list, void *param), void *param){
+  cs_calendar_t *cal = impl;
+  cs_event_list_t *list, *next;
+  int i;
+  for(i=0; i<cal->nbuckets; i++)
+    for(list = cal->buckets[i]; list!=NULL; list = next){
+      next = list->cnext;
+      func(list, param);
+    }
+}
+
+void _cal_destroy(void *impl, void (*func) (void *item, void *param)){
+  cs_calendar_t *cal = impl;
+  cs_event_list_t *list, *next;
+  int i;
+  for(i=0; i<cal->nbuckets && func!=NULL; i++)
+    for(list = cal->buckets[i]; list!=NULL; list = next){
+      next = list->cnext;
+      func(list, NULL);
+    }
+  free(cal->buckets);
+  free(cal);
+}
+
+cs_calendar_t *_cal_create(){
+  cs_calendar_t *cal = (cs_calendar_t *) calloc(1, sizeof(cs_calendar_t));
+  if(cal==NULL)
+    return NULL;
+  cal->nbuckets = CAL_MIN_BUCKETS;
+  cal->width = 1;
+  if(!(cal->buckets = (cs_event_list_t **) calloc(cal->nbuckets, sizeof(cs_event_list_t *)))){
+    free(cal);
+    return NULL;
+  }
+  return cal;
+}
+
+const cs_evstore_ops_t _cs_calendar_ops = {
+  _cal_find, _cal_insert, _cal_remove, _cal_first, _cal_last, _cal_count, _cal_walk, _cal_destroy
+};
+
+/*
+* Public interface.
+*/
+
+cs_evstore_t *cs_evstore_create(cs_evstore_type type){
+  cs_evstore_t *st = (cs_evstore_t *) calloc(1, sizeof(cs_evstore_t));
+  if(st==NULL){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error while allocating the event store");
+    return NULL;
+  }
+
+  st->type = type;
+  switch(type){
+    case CS_EVSTORE_RBTREE:
+      st->ops = &_cs_rbtree_ops;
+      st->impl = rb_create(cmp_event_list, NULL, &rb_allocator_default);
+      break;
+    case CS_EVSTORE_CALENDAR:
+      st->ops = &_cs_calendar_ops;
+      st->impl = _cal_create();
+      break;
+  }
+
+  if(st->impl==NULL){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Impossible to create the event store (type %d)", type);
+    free(st);
+    return NULL;
+  }
+  return st;
+}
+
+void cs_evstore_destroy(cs_evstore_t *st, void (*func) (void *item, void *param)){
+  st->ops->destroy(st->impl, func);
+  free(st);
+}
+
+cs_event_list_t *cs_evstore_find(cs_evstore_t *st, cs_clockv at){
+  return st->ops->find(st->impl, at);
+}
+
+int cs_evstore_insert(cs_evstore_t *st, cs_event_list_t *list){
+  return st->ops->insert(st->impl, list);
+}
+
+cs_event_list_t *cs_evstore_remove(cs_evstore_t *st, cs_clockv at){
+  return st->ops->remove(st->impl, at);
+}
+
+cs_event_list_t *cs_evstore_first(cs_evstore_t *st){
+  return st->ops->first(st->impl);
+}
+
+cs_event_list_t *cs_evstore_last(cs_evstore_t *st){
+  return st->ops->last(st->impl);
+}
+
+int cs_evstore_count(cs_evstore_t *st){
+  return st->ops->count(st->impl);
+}
+
+void cs_evstore_walk(cs_evstore_t *st, void (*func) (cs_event_list_t *list, void *param), void *param){
+  st->ops->walk(st->impl, func, param);
+}
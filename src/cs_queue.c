@@ -13,6 +13,30 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 #include "cs_queue.h"
 #include "cs_psk.h"
+#include "cs_stats.h"
+
+/*
+* Internal function. Wait on the semaphore sem; when the 
+* counters of the queue are enabled, the time spent blocked 
+* is stored into waited.
+*/
+int _cs_queue_sem_wait(cs_queue * q, sem_t *sem, unsigned long long *waited)
+{
+    unsigned long long start;
+    *waited = 0;
+
+    if (q->stats == NULL)
+	return sem_wait(sem);
+
+    if (sem_trywait(sem) == 0)	//no need to wait
+	return 0;
+
+    start = cs_stats_now_ns();
+    if (sem_wait(sem) != 0)
+	return -1;
+    *waited = cs_stats_now_ns() - start;
+    return 0;
+}
 
 int cs_queue_close(cs_queue * q)
 {
@@ -51,6 +75,7 @@ int cs_queue_init(cs_queue *q, const char *name, void (*memfree_func) (void *),
     q->head = q->tail = NULL;
     q->status = QOPENED;
     q->rel_func = memfree_func;
+    q->stats = NULL;
 
     q->qmutex = (pthread_mutex_t *) calloc(1, sizeof(pthread_mutex_t));
     if (q->qmutex == NULL) {
@@ -72,6 +97,52 @@ int cs_queue_init(cs_queue *q, const char *name, void (*memfree_func) (void *),
     return 0;
 }
 
+int cs_queue_enable_stats(cs_queue * q, short int enable)
+{
+    if (_CS_QUEUE_LOCK(q) != 0)
+	return -1;
+
+    if (enable && q->stats == NULL) {
+	if ((q->stats = (cs_queue_stats_t *) calloc(1, sizeof(cs_queue_stats_t))) == NULL) {
+	    log4c_category_log(log4c_category_get("cs.queue"), LOG4C_PRIORITY_ERROR, "Unable to alloc the counters for the queue %s", q->name);
+	    _CS_QUEUE_UNLOCK(q);
+	    return -1;
+	}
+	q->stats->depth = q->stats->max_depth = q->size;
+    }
+
+    else if (!enable && q->stats != NULL) {
+	free(q->stats);
+	q->stats = NULL;
+    }
+
+    if (_CS_QUEUE_UNLOCK(q) != 0)
+	return -1;
+    return 0;
+}
+
+int cs_queue_get_stats(cs_queue * q, cs_queue_stats_t * snapshot)
+{
+    int ret = -1;
+    _CS_QUEUE_LOCK(q);
+    if (q->stats != NULL) {
+	memcpy(snapshot, q->stats, sizeof(cs_queue_stats_t));
+	ret = 0;
+    }
+    _CS_QUEUE_UNLOCK(q);
+    return ret;
+}
+
+void cs_queue_reset_stats(cs_queue * q)
+{
+    _CS_QUEUE_LOCK(q);
+    if (q->stats != NULL) {
+	memset(q->stats, 0, sizeof(cs_queue_stats_t));
+	q->stats->depth = q->stats->max_depth = q->size;
+    }
+    _CS_QUEUE_UNLOCK(q);
+}
+
 int cs_queue_size(cs_queue * q)
 {
     int ret;
@@ -97,6 +168,7 @@ void cs_queue_destroy(cs_queue * q)
 	    pthread_mutex_destroy(q->qmutex);
 	    free(q->qmutex);
 	}
+	free(q->stats);
 
 	cs_qelem *current = q->tail;
 	//qelem *prev; 
@@ -113,9 +185,10 @@ int cs_queue_enqueue(cs_queue * q, void *data, short int blocking)
 {
     //int prev_size;
     cs_qelem *elem;
+    unsigned long long waited = 0;
 
     if (blocking) {
-	if (sem_wait(q->qlimit_sem) != 0) {	//wait in the semaphore
+	if (_cs_queue_sem_wait(q, q->qlimit_sem, &waited) != 0) {	//wait in the semaphore
 	    fprintf(stderr,
 		    "enqueue(): Error waiting in the \"limit\" semaphore\n");
 	    return -1;
@@ -163,6 +236,15 @@ int cs_queue_enqueue(cs_queue * q, void *data, short int blocking)
 
 	q->size++;
 
+	if (q->stats != NULL) {
+	    elem->enq_ns = cs_stats_now_ns();
+	    q->stats->enqueues++;
+	    q->stats->producer_blocked_ns += waited;
+	    q->stats->depth = q->size;
+	    if (q->size > q->stats->max_depth)
+		q->stats->max_depth = q->size;
+	}
+
 	if (sem_post(q->qsem) != 0) {	//post the semaphore  
 	    fprintf(stderr,
 		    "enqueue(): Error while increasing semaphore\n");
@@ -197,9 +279,10 @@ void *cs_queue_dequeue(cs_queue * q, short int blocking)
     cs_qelem *elem;
     int old_size;
     int assctl;
+    unsigned long long waited = 0;
 
     if (blocking) {
-	if (sem_wait(q->qsem) != 0) {	//SEM_WAIT
+	if (_cs_queue_sem_wait(q, q->qsem, &waited) != 0) {	//SEM_WAIT
 	    fprintf(stderr,
 		    "task_dequeue(): Error while decreasing semaphore of task queue\n");
 	    return NULL;
@@ -237,6 +320,14 @@ void *cs_queue_dequeue(cs_queue * q, short int blocking)
 	q->tail = q->head = NULL;
 
     q->size--;
+
+    if (q->stats != NULL) {
+	q->stats->dequeues++;
+	q->stats->consumer_blocked_ns += waited;
+	q->stats->depth = q->size;
+	if (elem->enq_ns != 0)	//enqueued after enabling the counters
+	    cs_log_hist_add(&q->stats->residence, cs_stats_now_ns() - elem->enq_ns);
+    }
     //thereafter, q->size == sem_getvalue()
     sem_getvalue(q->qsem, &assctl);
     assert(q->size == assctl || q->status==QCLOSED);
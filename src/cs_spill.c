@@ -0,0 +1,225 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "complex_sim.h"
+#include "cs_spill.h"
+#include "cs_concurrence.h"
+
+int _cs_spill_cmp_bucket(const void *b1, const void *b2, void *param){
+  long int i1 = ((const cs_spill_bucket_t *) b1)->idx, i2 = ((const cs_spill_bucket_t *) b2)->idx;
+  return (i1 < i2 ? -1 : (i1 > i2 ? 1 : 0));
+}
+
+void _cs_spill_free_bucket(void *item, void *param){
+  cs_spill_bucket_t *b = (cs_spill_bucket_t *) item;
+  free(b->blocks);
+  free(b->tail);
+  free(b);
+}
+
+int _cs_spill_init(cs_event_manager_t *evm, cs_clockv horizon, const char *path){
+  cs_spill_t *sp;
+
+  if(!(sp = (cs_spill_t *) calloc(1, sizeof(cs_spill_t))))
+    return -1;
+  sp->horizon = horizon;
+  sp->file = (path!=NULL ? fopen(path, "w+b") : tmpfile());
+  sp->buckets = rb_create(_cs_spill_cmp_bucket, NULL, &rb_allocator_default);
+  sp->lock = cs_make_mutex();
+  if(sp->file==NULL || sp->buckets==NULL || sp->lock==NULL){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Impossible to create the spill file %s", (path!=NULL ? path : "(temporary)"));
+    if(sp->file!=NULL)
+      fclose(sp->file);
+    if(sp->buckets!=NULL)
+      rb_destroy(sp->buckets, NULL);
+    free(sp->lock);
+    free(sp);
+    return -1;
+  }
+  sp->base = horizon;
+  evm->spill = sp;
+  return 0;
+}
+
+/*
+* Write the tail of the bucket b to the end of the file.
+*/
+int _cs_spill_flush(cs_spill_t *sp, cs_spill_bucket_t *b){
+  long int *blocks;
+  if(b->nblocks==b->blocks_size){
+    if(!(blocks = (long int *) realloc(b->blocks, MAX(4, 2*b->blocks_size)*sizeof(long int))))
+      return -1;
+    b->blocks = blocks;
+    b->blocks_size = MAX(4, 2*b->blocks_size);
+  }
+  if(fseek(sp->file, sp->end, SEEK_SET)!=0 ||
+     fwrite(b->tail, sizeof(cs_spill_rec_t), CS_SPILL_BLOCK, sp->file)!=CS_SPILL_BLOCK)
+    return -1;
+  b->blocks[b->nblocks++] = sp->end;
+  sp->end+=CS_SPILL_BLOCK*sizeof(cs_spill_rec_t);
+  b->ntail = 0;
+  return 0;
+}
+
+int _cs_spill_event(cs_event_manager_t *evm, cs_event_t *ev, cs_clockv at){
+  cs_spill_t *sp = evm->spill;
+  cs_spill_bucket_t search, *b;
+  cs_spill_rec_t *rec;
+  int ret = 0;
+
+  //only the events which can be rebuilt from the record
+  if(sp==NULL || at<__atomic_load_n(&sp->base, __ATOMIC_ACQUIRE) || !_cs_evm_is_pooled(evm, ev) ||
+     (ev->flags & CS_EV_HANDLED) || (ev->ev_data!=NULL && !CS_EV_DATA_IS_INLINE(ev)))
+    return 1;
+
+  pthread_mutex_lock(sp->lock);
+  search.idx = at/sp->horizon;
+  if((b = (cs_spill_bucket_t *) rb_find(sp->buckets, &search))==NULL){
+    if(!(b = (cs_spill_bucket_t *) calloc(1, sizeof(cs_spill_bucket_t))) ||
+       !(b->tail = (cs_spill_rec_t *) malloc(CS_SPILL_BLOCK*sizeof(cs_spill_rec_t)))){
+      free(b);
+      pthread_mutex_unlock(sp->lock);
+      return -1;
+    }
+    b->idx = search.idx;
+    b->min_at = b->max_at = at;
+    rb_insert(sp->buckets, b);
+  }
+
+  rec = &b->tail[b->ntail++];
+  rec->at = at;
+  rec->target = ev->target;
+  rec->etid = ev->etid;
+  rec->has_data = (ev->ev_data!=NULL);
+  memcpy(rec->data, ev->ev_inline, CS_EV_INLINE_SIZE);
+  if(b->ntail==CS_SPILL_BLOCK && _cs_spill_flush(sp, b)<0){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Error writing the spill file");
+    b->ntail--;
+    ret = -1;
+  }
+  else{
+    b->min_at = MIN(b->min_at, at);
+    b->max_at = MAX(b->max_at, at);
+    b->n++;
+    sp->written++;
+    __atomic_store_n(&sp->n, sp->n+1, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(sp->lock);
+
+  //the event now lives in the file
+  if(ret==0)
+    _cs_evm_event_done(evm, ev);
+  return ret;
+}
+
+/*
+* Rebuild the event of rec, and store it.
+*/
+void _cs_spill_load(cs_event_manager_t *evm, cs_spill_rec_t *rec){
+  cs_event_t *ev;
+  if((ev = cs_evm_alloc_event(evm->type_names[rec->etid], NULL, evm))==NULL){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Spilled event at %li lost", (long int) rec->at);
+    return;
+  }
+  ev->etid = rec->etid;
+  ev->target = rec->target;
+  if(rec->has_data){
+    memcpy(ev->ev_inline, rec->data, CS_EV_INLINE_SIZE);
+    ev->ev_data = CS_EV_INLINE(ev);
+  }
+  ev->pending = 1;
+  if(_cs_evm_store_event(evm, ev, rec->at)<0){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Spilled event at %li lost", (long int) rec->at);
+    _cs_evm_event_done(evm, ev);
+  }
+}
+
+void _cs_spill_page_in(cs_event_manager_t *evm, cs_clockv cur_time){
+  cs_spill_t *sp = evm->spill;
+  cs_spill_rec_t block[CS_SPILL_BLOCK];
+  struct rb_traverser trav;
+  cs_spill_bucket_t *b;
+  int i, j;
+
+  if(sp==NULL)
+    return;
+  pthread_mutex_lock(sp->lock);
+  //from now on the events before cur_time+horizon stay in memory
+  if(cur_time+sp->horizon > sp->base)
+    __atomic_store_n(&sp->base, cur_time+sp->horizon, __ATOMIC_RELEASE);
+
+  while((b = (cs_spill_bucket_t *) rb_t_first(&trav, sp->buckets))!=NULL && b->idx*sp->horizon < sp->base){
+    rb_delete(sp->buckets, b);
+    for(i=0; i<b->nblocks; i++){
+      if(fseek(sp->file, b->blocks[i], SEEK_SET)!=0 ||
+	 fread(block, sizeof(cs_spill_rec_t), CS_SPILL_BLOCK, sp->file)!=CS_SPILL_BLOCK){
+	log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Error reading the spill file, %i events lost", CS_SPILL_BLOCK);
+	continue;
+      }
+      for(j=0; j<CS_SPILL_BLOCK; j++)
+	_cs_spill_load(evm, &block[j]);
+    }
+    for(j=0; j<b->ntail; j++)
+      _cs_spill_load(evm, &b->tail[j]);
+    __atomic_store_n(&sp->n, sp->n-b->n, __ATOMIC_RELEASE);
+    _cs_spill_free_bucket(b, NULL);
+  }
+  pthread_mutex_unlock(sp->lock);
+}
+
+cs_clockv _cs_spill_nearest(cs_event_manager_t *evm){
+  cs_spill_t *sp = evm->spill;
+  struct rb_traverser trav;
+  cs_spill_bucket_t *b;
+  cs_clockv nearest = -1;
+
+  if(sp==NULL || __atomic_load_n(&sp->n, __ATOMIC_ACQUIRE)==0)
+    return -1;
+  pthread_mutex_lock(sp->lock);
+  if((b = (cs_spill_bucket_t *) rb_t_first(&trav, sp->buckets))!=NULL)
+    nearest = b->min_at;
+  pthread_mutex_unlock(sp->lock);
+  return nearest;
+}
+
+cs_clockv _cs_spill_farthest(cs_event_manager_t *evm){
+  cs_spill_t *sp = evm->spill;
+  struct rb_traverser trav;
+  cs_spill_bucket_t *b;
+  cs_clockv farthest = -1;
+
+  if(sp==NULL || __atomic_load_n(&sp->n, __ATOMIC_ACQUIRE)==0)
+    return -1;
+  pthread_mutex_lock(sp->lock);
+  if((b = (cs_spill_bucket_t *) rb_t_last(&trav, sp->buckets))!=NULL)
+    farthest = b->max_at;
+  pthread_mutex_unlock(sp->lock);
+  return farthest;
+}
+
+long int cs_evm_spilled_events(cs_event_manager_t *evm){
+  return (evm->spill!=NULL ? evm->spill->written : 0);
+}
+
+void _cs_spill_destroy(cs_event_manager_t *evm){
+  cs_spill_t *sp = evm->spill;
+  if(sp==NULL)
+    return;
+  rb_destroy(sp->buckets, _cs_spill_free_bucket);
+  fclose(sp->file);
+  pthread_mutex_destroy(sp->lock);
+  free(sp->lock);
+  free(sp);
+  evm->spill = NULL;
+}
@@ -0,0 +1,81 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <string.h>
+#include <time.h>
+
+#include "cs_stats.h"
+
+unsigned long long cs_stats_now_ns(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((unsigned long long) ts.tv_sec)*1000000000ULL + (unsigned long long) ts.tv_nsec;
+}
+
+void cs_log_hist_reset(cs_log_hist_t *h){
+  memset(h, 0, sizeof(cs_log_hist_t));
+}
+
+/*
+* Index of the bucket for the value v, i.e. the
+* number of significant bits of v.
+*/
+int _cs_log_hist_bucket(unsigned long long v){
+  int b = 0;
+  while(v!=0 && b<CS_LOG_HIST_BUCKETS-1){
+    v>>=1;
+    b++;
+  }
+  return b;
+}
+
+void cs_log_hist_add(cs_log_hist_t *h, unsigned long long v){
+  h->count[_cs_log_hist_bucket(v)]++;
+  h->samples++;
+  h->sum+=v;
+  if(v>h->max)
+    h->max = v;
+}
+
+void cs_log_hist_merge(cs_log_hist_t *dst, const cs_log_hist_t *src){
+  int i;
+  for(i=0; i<CS_LOG_HIST_BUCKETS; i++)
+    dst->count[i]+=src->count[i];
+  dst->samples+=src->samples;
+  dst->sum+=src->sum;
+  if(src->max>dst->max)
+    dst->max = src->max;
+}
+
+unsigned long long cs_log_hist_bucket_bound(int bucket){
+  if(bucket<=0)
+    return 1ULL;
+  if(bucket>=CS_LOG_HIST_BUCKETS-1)
+    return ~0ULL;
+  return 1ULL<<bucket;
+}
+
+unsigned long long cs_log_hist_percentile(const cs_log_hist_t *h, double p){
+  unsigned long long seen = 0, rank;
+  int i;
+  if(h->samples==0)
+    return 0;
+  rank = (unsigned long long) ((p/100.0)*h->samples);
+  if(rank>=h->samples)
+    rank = h->samples-1;
+  for(i=0; i<CS_LOG_HIST_BUCKETS; i++){
+    seen+=h->count[i];
+    if(seen>rank)
+      return (i==CS_LOG_HIST_BUCKETS-1 ? h->max : cs_log_hist_bucket_bound(i));
+  }
+  return h->max;
+}
@@ -30,6 +30,7 @@ void _cs_init_timer(cs_timer_t *t, const char *id, int n_sync){
   else
     log4c_category_log(log4c_category_get("cs.timer"), LOG4C_PRIORITY_ERROR, "Parameter n_sync must be greater than zero", t->id);
   t->clock = 0;
+  t->next = -1;
   t->stop=0;
 }
 
@@ -56,6 +57,10 @@ cs_clockv cs_get_clock(cs_timer_t * t){
 }
 
 int cs_time_sync(cs_timer_t *t){
+  return cs_time_sync_to(t, 0);
+}
+
+int cs_time_sync_to(cs_timer_t *t, cs_clockv at){
   int ret;
   pthread_mutex_lock(t->mutex);
   if(t->stop==0){
@@ -65,8 +70,13 @@ int cs_time_sync(cs_timer_t *t){
       return -1;
     }
     t->sync++;
+    if(at<=t->clock)
+      at = t->clock+1;
+    if(t->next<0 || at<t->next)
+      t->next = at;
     if(t->sync==t->n_sync){
-      t->clock++;
+      t->clock = t->next;
+      t->next = -1;
       t->sync=0;
       pthread_cond_broadcast(t->cond);
     }
@@ -0,0 +1,432 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "complex_sim.h"
+#include "cs_timewarp.h"
+#include "cs_spill.h"
+#include "cs_trace.h"
+
+/*
+* The partition being handled by a worker, and the event of its log 
+* being handled.
+*/
+typedef struct _cs_tw_sender_s{
+  int part;
+  int rec;
+  cs_clockv now;
+}_cs_tw_sender_t;
+
+/*
+* Whether the message m1 comes before the message m2.
+*/
+#define _CS_TW_BEFORE(m1, m2) ((m1)->at < (m2)->at || ((m1)->at == (m2)->at && (m1)->seq < (m2)->seq))
+
+int _cs_tw_heap_push(cs_tw_part_t *part, cs_tw_msg_t *msg){
+  cs_tw_msg_t **heap;
+  int i, parent;
+  if(part->nheap==part->heap_size){
+    if(!(heap = (cs_tw_msg_t **) realloc(part->heap, MAX(16, 2*part->heap_size)*sizeof(cs_tw_msg_t *))))
+      return -1;
+    part->heap = heap;
+    part->heap_size = MAX(16, 2*part->heap_size);
+  }
+  for(i=part->nheap++; i>0 && _CS_TW_BEFORE(msg, part->heap[(parent = (i-1)/2)]); i=parent)
+    part->heap[i] = part->heap[parent];
+  part->heap[i] = msg;
+  return 0;
+}
+
+cs_tw_msg_t *_cs_tw_heap_pop(cs_tw_part_t *part){
+  cs_tw_msg_t *top, *last;
+  int i, child;
+  if(part->nheap==0)
+    return NULL;
+  top = part->heap[0];
+  last = part->heap[--part->nheap];
+  for(i=0; (child = 2*i+1)<part->nheap; i=child){
+    if(child+1<part->nheap && _CS_TW_BEFORE(part->heap[child+1], part->heap[child]))
+      child++;
+    if(!_CS_TW_BEFORE(part->heap[child], last))
+      break;
+    part->heap[i] = part->heap[child];
+  }
+  part->heap[i] = last;
+  return top;
+}
+
+/*
+* A new message, allocated by (and freed with) the partition part.
+*/
+cs_tw_msg_t *_cs_tw_new_msg(cs_timewarp_t *tw, cs_tw_part_t *part, cs_event_t *ev, cs_clockv at){
+  cs_tw_msg_t *msg;
+  if(!(msg = (cs_tw_msg_t *) malloc(sizeof(cs_tw_msg_t)))){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error allocating an optimistic message");
+    return NULL;
+  }
+  msg->ev = ev;
+  msg->at = at;
+  msg->seq = __sync_fetch_and_add(&tw->seq, 1);
+  msg->part = _CS_EVM_PART(ev, tw->nparts);
+  msg->rec = -1;
+  msg->next_send = NULL;
+  msg->next_alloc = part->allocated;
+  part->allocated = msg;
+  return msg;
+}
+
+/*
+* The hook taking the events scheduled by the handlers run speculatively.
+*/
+int _cs_tw_send(cs_event_t *ev, cs_clockv at, void *arg, cs_event_manager_t *evm){
+  cs_timewarp_t *tw = evm->tw;
+  _cs_tw_sender_t *sender = (_cs_tw_sender_t *) arg;
+  cs_tw_part_t *part = &tw->parts[sender->part];
+  cs_tw_msg_t *msg, **out;
+
+  if(at<sender->now){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Event %s scheduled in the past (%li<%li) in optimistic mode", ev->etype, (long int) at, (long int) sender->now);
+    return -1;
+  }
+  if((msg = _cs_tw_new_msg(tw, part, ev, at))==NULL)
+    return -1;
+
+  if(at>=tw->end)
+    msg->state = CS_TW_FUTURE;
+  else if(msg->part==sender->part){
+    msg->state = CS_TW_QUEUED;
+    if(_cs_tw_heap_push(part, msg)<0)
+      return -1;
+  }
+  else{
+    if(part->nout==part->out_size){
+      if(!(out = (cs_tw_msg_t **) realloc(part->out, MAX(16, 2*part->out_size)*sizeof(cs_tw_msg_t *))))
+	return -1;
+      part->out = out;
+      part->out_size = MAX(16, 2*part->out_size);
+    }
+    msg->state = CS_TW_OUT;
+    part->out[part->nout++] = msg;
+  }
+  msg->next_send = part->log[sender->rec].sends;
+  part->log[sender->rec].sends = msg;
+  return 0;
+}
+
+/*
+* Handle the queue of the partition p, in time order.
+*/
+int _cs_tw_run_part(cs_event_manager_t *evm, int p, int index){
+  cs_timewarp_t *tw = evm->tw;
+  cs_tw_part_t *part = &tw->parts[p];
+  _cs_tw_sender_t sender;
+  cs_tw_rec_t *log;
+  cs_tw_msg_t *msg;
+
+  sender.part = p;
+  while((msg = _cs_tw_heap_pop(part))!=NULL){
+    if(msg->state==CS_TW_CANCELLED)
+      continue;
+    if(part->nlog==part->log_size){
+      if(!(log = (cs_tw_rec_t *) realloc(part->log, MAX(16, 2*part->log_size)*sizeof(cs_tw_rec_t)))){
+	log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error growing the optimistic log");
+	return -1;
+      }
+      part->log = log;
+      part->log_size = MAX(16, 2*part->log_size);
+    }
+    log = &part->log[part->nlog];
+    log->msg = msg;
+    log->sends = NULL;
+    log->state = (tw->save!=NULL ? tw->save(msg->ev->target, tw->arg) : NULL);
+    msg->state = CS_TW_PROCESSED;
+    msg->rec = part->nlog++;
+
+    sender.rec = msg->rec;
+    sender.now = msg->at;
+    _cs_evm_run_handler(evm, msg->ev, msg->at, index, _cs_tw_send, &sender);
+  }
+  return 0;
+}
+
+/*
+* A task of a phase: it claims partitions until they are over.
+*/
+cs_wp_tsk_exit_status _cs_tw_task(cs_data_ptr in, cs_data_ptr *out){
+  cs_tw_task_t *task = (cs_tw_task_t *) in;
+  cs_timewarp_t *tw = task->evm->tw;
+  cs_wp_tsk_exit_status ret = CS_TSK_SUCCESS;
+  int p;
+
+  while((p = __sync_fetch_and_add(&tw->cursor, 1))<tw->nparts)
+    if(_cs_tw_run_part(task->evm, p, task->index)<0)
+      ret = CS_TSK_ERROR;
+  return ret;
+}
+
+void _cs_tw_cancel(cs_event_manager_t *evm, cs_tw_msg_t *msg);
+
+/*
+* Roll back the partition p, until its log has only nkeep events.
+*/
+void _cs_tw_undo(cs_event_manager_t *evm, int p, int nkeep){
+  cs_timewarp_t *tw = evm->tw;
+  cs_tw_part_t *part = &tw->parts[p];
+  cs_tw_rec_t rec;
+  cs_tw_msg_t *s;
+
+  if(part->nlog>nkeep)
+    tw->stats.rollbacks++;
+
+  //the log may shrink further, by the rollbacks caused by the annihilations
+  while(part->nlog>nkeep){
+    rec = part->log[--part->nlog];
+    if(tw->restore!=NULL)
+      tw->restore(rec.msg->ev->target, rec.state, tw->arg);
+    if(tw->discard!=NULL)
+      tw->discard(rec.msg->ev->target, rec.state, tw->arg);
+    rec.msg->state = CS_TW_QUEUED;
+    rec.msg->rec = -1;
+    if(_cs_tw_heap_push(part, rec.msg)<0)
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error rolling back, event lost");
+    tw->stats.rolled_back++;
+
+    //anti-messages
+    for(s=rec.sends; s!=NULL; s=s->next_send)
+      _cs_tw_cancel(evm, s);
+  }
+}
+
+/*
+* Annihilate a message sent by an event which has been rolled back.
+*/
+void _cs_tw_cancel(cs_event_manager_t *evm, cs_tw_msg_t *msg){
+  switch(msg->state){
+    case CS_TW_CANCELLED:
+      return;
+    case CS_TW_PROCESSED:
+      _cs_tw_undo(evm, msg->part, msg->rec);
+      break;
+    default:
+      break;
+  }
+  msg->state = CS_TW_CANCELLED;
+  evm->tw->stats.cancelled++;
+  _cs_evm_event_done(evm, msg->ev);
+}
+
+/*
+* Deliver the messages sent between the partitions during the phase,
+* rolling back the partitions which have already handled later events.
+* @return the number of messages delivered.
+*/
+int _cs_tw_deliver(cs_event_manager_t *evm){
+  cs_timewarp_t *tw = evm->tw;
+  cs_tw_part_t *part, *dest;
+  cs_tw_msg_t *msg;
+  int p, i, n = 0, nkeep;
+
+  for(p=0; p<tw->nparts; p++){
+    part = &tw->parts[p];
+    for(i=0; i<part->nout; i++){
+      if((msg = part->out[i])->state!=CS_TW_OUT)
+	continue;
+      dest = &tw->parts[msg->part];
+      //straggler: roll back the events after it
+      for(nkeep=dest->nlog; nkeep>0 && dest->log[nkeep-1].msg->at>msg->at; nkeep--);
+      _cs_tw_undo(evm, msg->part, nkeep);
+      msg->state = CS_TW_QUEUED;
+      if(_cs_tw_heap_push(dest, msg)<0)
+	log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error delivering an optimistic message, event lost");
+      n++;
+    }
+    part->nout = 0;
+  }
+  return n;
+}
+
+/*
+* Commit the events of the window: the GVT is the end of the window.
+*/
+void _cs_tw_commit(cs_event_manager_t *evm){
+  cs_timewarp_t *tw = evm->tw;
+  cs_tw_part_t *part;
+  cs_tw_msg_t *s, *next;
+  cs_tw_rec_t *rec;
+  int p, i;
+
+  for(p=0; p<tw->nparts; p++){
+    part = &tw->parts[p];
+    for(i=0; i<part->nlog; i++){
+      rec = &part->log[i];
+      //fossil collection
+      if(tw->discard!=NULL)
+	tw->discard(rec->msg->ev->target, rec->state, tw->arg);
+      for(s=rec->sends; s!=NULL; s=s->next_send)
+	if(s->state==CS_TW_FUTURE && _cs_evm_store_event(evm, s->ev, s->at)<0){
+	  log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Event %s scheduled at %li lost", s->ev->etype, (long int) s->at);
+	  _cs_evm_event_done(evm, s->ev);
+	}
+      if(evm->trace!=NULL)
+	_cs_trace_events(evm, &rec->msg->ev, 1, rec->msg->at);
+      _cs_evm_event_done(evm, rec->msg->ev);
+    }
+    tw->stats.committed+=part->nlog;
+    part->nlog = 0;
+    part->nheap = 0;
+  }
+
+  //the messages go to other partitions: released once all are committed
+  for(p=0; p<tw->nparts; p++){
+    part = &tw->parts[p];
+    for(s=part->allocated; s!=NULL; s=next){
+      next = s->next_alloc;
+      free(s);
+    }
+    part->allocated = NULL;
+  }
+}
+
+int _cs_tw_run_window(cs_event_manager_t *evm, cs_clockv cur_time){
+  cs_timewarp_t *tw = evm->tw;
+  cs_tw_part_t *part;
+  cs_tw_msg_t *msg;
+  cs_wp_tsk_id *id_arr;
+  int i, c, more, ret = 0;
+
+  tw->end = cur_time+tw->window;
+  if(_cs_evm_gather_window(evm, tw->end)<0)
+    return -1;
+  if(evm->win.count==0)
+    return 0;
+
+  //the events of the window go to the queues of their partitions
+  for(i=0; i<evm->win.count; i++){
+    part = &tw->parts[_CS_EVM_PART(evm->win.evs[i], tw->nparts)];
+    if((msg = _cs_tw_new_msg(tw, part, evm->win.evs[i], evm->win_at[i]))==NULL ||
+       _cs_tw_heap_push(part, msg)<0){
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error queueing the events of the window at %li", (long int) cur_time);
+      return -1;
+    }
+    msg->state = CS_TW_QUEUED;
+  }
+  evm->win.count = 0;
+
+  if(!(id_arr = (cs_wp_tsk_id *) calloc(tw->ntasks, sizeof(cs_wp_tsk_id))))
+    return -1;
+
+  //phases, until no message goes from a partition to another
+  do{
+    tw->cursor = 0;
+    for(c=0; c<tw->ntasks; c++)
+      if((id_arr[c] = cs_wp_tsk_enqueue(_cs_tw_task, (void *) &tw->tasks[c], sizeof(cs_tw_task_t), evm->wp))<0){
+	log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Impossible to enqueue optimistic task at %li", (long int) cur_time);
+	ret = -1;
+      }
+    for(c=0; c<tw->ntasks; c++)
+      if(id_arr[c]>=0)
+	cs_wp_tsk_wait(evm->wp, id_arr[c]);
+    tw->stats.phases++;
+
+    more = (_cs_tw_deliver(evm)>0);
+    for(i=0; i<tw->nparts && !more; i++)
+      more = (tw->parts[i].nheap>0);
+  }while(more && ret==0);
+
+  _cs_tw_commit(evm);
+  free(id_arr);
+  return ret;
+}
+
+int cs_evm_enable_timewarp(
+  cs_event_manager_t *evm,
+  cs_clockv window,
+  cs_tw_save_state_t save,
+  cs_tw_restore_state_t restore,
+  cs_tw_discard_state_t discard,
+  void *arg)
+{
+  cs_timewarp_t *tw;
+  int i;
+
+  if(window<1 || (save!=NULL && restore==NULL)){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_enable_timewarp(), invalid parameters");
+    return -1;
+  }
+  //the spilled events must be back before their window
+  if(evm->spill!=NULL && evm->spill->horizon<window){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_enable_timewarp(), the window is larger than the spill horizon");
+    return -1;
+  }
+  if(evm->group!=NULL){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_enable_timewarp(), the optimistic mode is not available for a group of event managers");
+    return -1;
+  }
+  if(cs_evm_running(evm) || evm->tw!=NULL){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_enable_timewarp(), the optimistic mode must be enabled once, before starting the controller");
+    return -1;
+  }
+  if(!(tw = (cs_timewarp_t *) calloc(1, sizeof(cs_timewarp_t)))){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error enabling the optimistic mode");
+    return -1;
+  }
+
+  tw->window = window;
+  tw->save = save;
+  tw->restore = restore;
+  tw->discard = discard;
+  tw->arg = arg;
+  tw->ntasks = MAX(1, evm->nworkers-1);
+  tw->nparts = 4*tw->ntasks;
+  if(!(tw->parts = (cs_tw_part_t *) calloc(tw->nparts, sizeof(cs_tw_part_t))) ||
+     !(tw->tasks = (cs_tw_task_t *) calloc(tw->ntasks, sizeof(cs_tw_task_t)))){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error enabling the optimistic mode");
+    free(tw->parts);
+    free(tw);
+    return -1;
+  }
+  for(i=0; i<tw->ntasks; i++){
+    tw->tasks[i].evm = evm;
+    tw->tasks[i].index = MIN(i, evm->nwbufs-1);
+  }
+  evm->tw = tw;
+  return 0;
+}
+
+int cs_evm_timewarp_stats(cs_event_manager_t *evm, cs_tw_stats_t *stats){
+  if(evm->tw==NULL)
+    return -1;
+  *stats = evm->tw->stats;
+  return 0;
+}
+
+void _cs_tw_destroy(cs_event_manager_t *evm){
+  cs_timewarp_t *tw = evm->tw;
+  cs_tw_msg_t *s, *next;
+  int p;
+  if(tw==NULL)
+    return;
+  for(p=0; p<tw->nparts; p++){
+    for(s=tw->parts[p].allocated; s!=NULL; s=next){
+      next = s->next_alloc;
+      free(s);
+    }
+    free(tw->parts[p].heap);
+    free(tw->parts[p].log);
+    free(tw->parts[p].out);
+  }
+  free(tw->parts);
+  free(tw->tasks);
+  free(tw);
+  evm->tw = NULL;
+}
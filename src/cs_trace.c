@@ -0,0 +1,334 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "complex_sim.h"
+#include "cs_trace.h"
+
+/*
+* The background writer: it writes the pages handed over by the tasks,
+* in order, and keeps them for reuse.
+*/
+void *_cs_trace_writer(void *arg){
+  cs_trace_t *tr = (cs_trace_t *) arg;
+  cs_trace_page_t pg;
+
+  pthread_mutex_lock(&tr->lock);
+  while(1){
+    while(tr->nqueued==0 && !tr->closing)
+      pthread_cond_wait(&tr->cond, &tr->lock);
+    if(tr->nqueued==0)
+      break;
+    pg = tr->queue[tr->head];
+    pthread_mutex_unlock(&tr->lock);
+    if(fwrite(pg.data, 1, pg.fill, tr->file)!=pg.fill)
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Error writing the trace");
+    pthread_mutex_lock(&tr->lock);
+    tr->head = (tr->head+1)%tr->qsize;
+    tr->nqueued--;
+    tr->spare[tr->nspare++] = pg.data;
+    pthread_cond_broadcast(&tr->cond);
+  }
+  pthread_mutex_unlock(&tr->lock);
+  return NULL;
+}
+
+/*
+* Hand the page of buf over to the writer, waiting while the queue is
+* full, and take a written page (or a new one) in its place. The lock 
+* is held.
+*/
+void _cs_trace_handover(cs_trace_t *tr, cs_trace_buf_t *buf){
+  if(buf->page==NULL || buf->fill==0)
+    return;
+  while(tr->nqueued==tr->qsize)
+    pthread_cond_wait(&tr->cond, &tr->lock);
+  tr->queue[(tr->head+tr->nqueued)%tr->qsize].data = buf->page;
+  tr->queue[(tr->head+tr->nqueued)%tr->qsize].fill = buf->fill;
+  tr->nqueued++;
+  pthread_cond_broadcast(&tr->cond);
+  buf->fill = 0;
+  if(tr->nspare>0)
+    buf->page = tr->spare[--tr->nspare];
+  else if(!(buf->page = (char *) malloc(CS_TRACE_PAGE)))
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error allocating a page of the trace, records lost");
+}
+
+/*
+* Append a record and its bytes to buf, handing its page over when 
+* full; locked tells whether the lock is held.
+* @return a value < 0 if the record is lost.
+*/
+int _cs_trace_append(cs_trace_t *tr, cs_trace_buf_t *buf, cs_trace_rec_t *rec, const void *bytes, short int locked){
+  char *page;
+  if(buf->fill+sizeof(cs_trace_rec_t)+rec->size > CS_TRACE_PAGE){
+    if(!locked)
+      pthread_mutex_lock(&tr->lock);
+    _cs_trace_handover(tr, buf);
+    if(!locked)
+      pthread_mutex_unlock(&tr->lock);
+  }
+  if(buf->page==NULL)
+    return -1;
+  page = buf->page+buf->fill;
+  memcpy(page, rec, sizeof(cs_trace_rec_t));
+  if(rec->size>0)
+    memcpy(page+sizeof(cs_trace_rec_t), bytes, rec->size);
+  buf->fill+=sizeof(cs_trace_rec_t)+rec->size;
+  return 0;
+}
+
+/*
+* Record the event ev in buf.
+*/
+void _cs_trace_record(cs_event_manager_t *evm, cs_trace_buf_t *buf, cs_event_t *ev, cs_clockv at, short int locked){
+  cs_trace_t *tr = evm->trace;
+  cs_trace_rec_t rec;
+
+  //the deliveries of a broadcast are not recorded, its carrier holds pointers
+  if(ev->etype==_cs_evm_broadcast_type)
+    return;
+  //the first event of a type in buf brings the name of the type
+  if(!buf->typed[ev->etid]){
+    rec.at = at;
+    rec.target = -1;
+    rec.etid = -ev->etid-1;
+    rec.size = strlen(evm->type_names[ev->etid])+1;
+    if(_cs_trace_append(tr, buf, &rec, evm->type_names[ev->etid], locked)<0)
+      return;
+    buf->typed[ev->etid] = 1;
+  }
+  rec.at = at;
+  rec.target = ev->target;
+  rec.etid = ev->etid;
+  rec.size = (ev->ev_data!=NULL && CS_EV_DATA_IS_INLINE(ev) ? CS_EV_INLINE_SIZE : 0);
+  if(_cs_trace_append(tr, buf, &rec, ev->ev_inline, locked)==0)
+    buf->nevents++;
+}
+
+void _cs_trace_events(cs_event_manager_t *evm, cs_event_t **evs, int n, cs_clockv at){
+  cs_trace_t *tr = evm->trace;
+  int index = _cs_evm_task_index(evm), i;
+  short int shared = (index<0 || index>=tr->nbufs-1);
+  cs_trace_buf_t *buf = &tr->bufs[shared ? tr->nbufs-1 : index];
+
+  if(__atomic_load_n(&tr->stop, __ATOMIC_ACQUIRE))
+    return;
+  if(shared)
+    pthread_mutex_lock(&tr->lock);
+  //either the stop sees the task busy, and waits, or the task sees the stop
+  __atomic_store_n(&buf->busy, 1, __ATOMIC_SEQ_CST);
+  if(!__atomic_load_n(&tr->stop, __ATOMIC_SEQ_CST))
+    for(i=0; i<n; i++)
+      _cs_trace_record(evm, buf, evs[i], at, shared);
+  __atomic_store_n(&buf->busy, 0, __ATOMIC_RELEASE);
+  if(shared)
+    pthread_mutex_unlock(&tr->lock);
+}
+
+/*
+* Release the pages of the trace.
+*/
+void _cs_trace_free_pages(cs_trace_t *tr){
+  int i;
+  for(i=0; i<tr->nbufs; i++){
+    free(tr->bufs[i].page);
+    tr->bufs[i].page = NULL;
+  }
+  while(tr->nspare>0)
+    free(tr->spare[--tr->nspare]);
+}
+
+int cs_evm_trace_start(cs_event_manager_t *evm, const char *path){
+  cs_trace_t *tr = evm->trace;
+  int header[2] = {CS_TRACE_MAGIC, CS_EV_INLINE_SIZE};
+  int i;
+
+  //the trace of evm is kept until its destruction, and reused
+  if(tr==NULL){
+    if(!(tr = (cs_trace_t *) calloc(1, sizeof(cs_trace_t))))
+      return -1;
+    tr->nbufs = evm->nwbufs+1;
+    tr->qsize = CS_TRACE_QUEUE*tr->nbufs;
+    if(!(tr->bufs = (cs_trace_buf_t *) calloc(tr->nbufs, sizeof(cs_trace_buf_t))) ||
+       !(tr->queue = (cs_trace_page_t *) calloc(tr->qsize, sizeof(cs_trace_page_t))) ||
+       !(tr->spare = (char **) calloc(tr->nbufs+tr->qsize, sizeof(char *)))){
+      log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Memory error allocating the trace");
+      free(tr->bufs);
+      free(tr->queue);
+      free(tr);
+      return -1;
+    }
+    tr->stop = 1;
+    pthread_mutex_init(&tr->lock, NULL);
+    pthread_cond_init(&tr->cond, NULL);
+    evm->trace = tr;
+  }
+  else if(!tr->stop){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_trace_start(), already tracing");
+    return -1;
+  }
+
+  for(i=0; i<tr->nbufs; i++){
+    tr->bufs[i].page = (char *) malloc(CS_TRACE_PAGE);
+    tr->bufs[i].fill = 0;
+    tr->bufs[i].nevents = 0;
+    memset(tr->bufs[i].typed, 0, sizeof(tr->bufs[i].typed));
+  }
+  for(i=0; i<tr->nbufs && tr->bufs[i].page!=NULL; i++);
+  if(i<tr->nbufs || !(tr->file = fopen(path, "wb")) ||
+     fwrite(header, sizeof(int), 2, tr->file)!=2){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Impossible to create the trace %s", path);
+    if(tr->file!=NULL)
+      fclose(tr->file);
+    tr->file = NULL;
+    _cs_trace_free_pages(tr);
+    return -1;
+  }
+  tr->head = tr->nqueued = 0;
+  tr->closing = 0;
+  if(pthread_create(&tr->writer, NULL, _cs_trace_writer, tr)!=0){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "Impossible to start the trace writer");
+    fclose(tr->file);
+    tr->file = NULL;
+    _cs_trace_free_pages(tr);
+    return -1;
+  }
+  __atomic_store_n(&tr->stop, 0, __ATOMIC_RELEASE);
+  return 0;
+}
+
+long int cs_evm_trace_stop(cs_event_manager_t *evm){
+  cs_trace_t *tr = evm->trace;
+  long int n = 0;
+  int i;
+
+  if(tr==NULL)
+    return -1;
+  pthread_mutex_lock(&tr->lock);
+  if(tr->stop){
+    pthread_mutex_unlock(&tr->lock);
+    return -1;
+  }
+  __atomic_store_n(&tr->stop, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&tr->lock);
+  //the tasks still appending to their buffers complete their records
+  for(i=0; i<tr->nbufs-1; i++)
+    while(__atomic_load_n(&tr->bufs[i].busy, __ATOMIC_SEQ_CST))
+      sched_yield();
+
+  pthread_mutex_lock(&tr->lock);
+  for(i=0; i<tr->nbufs; i++){
+    _cs_trace_handover(tr, &tr->bufs[i]);
+    n+=tr->bufs[i].nevents;
+  }
+  tr->closing = 1;
+  pthread_cond_broadcast(&tr->cond);
+  pthread_mutex_unlock(&tr->lock);
+  pthread_join(tr->writer, NULL);
+
+  fclose(tr->file);
+  tr->file = NULL;
+  _cs_trace_free_pages(tr);
+  return n;
+}
+
+void _cs_trace_destroy(cs_event_manager_t *evm){
+  cs_trace_t *tr = evm->trace;
+  if(tr==NULL)
+    return;
+  cs_evm_trace_stop(evm);
+  free(tr->bufs);
+  free(tr->queue);
+  free(tr->spare);
+  pthread_mutex_destroy(&tr->lock);
+  pthread_cond_destroy(&tr->cond);
+  free(tr);
+  evm->trace = NULL;
+}
+
+/*
+* The hook of the replay: the events scheduled by the handlers are dropped.
+*/
+int _cs_trace_drop(cs_event_t *ev, cs_clockv at, void *arg, cs_event_manager_t *evm){
+  _cs_evm_event_done(evm, ev);
+  return 0;
+}
+
+long int cs_evm_trace_replay(cs_event_manager_t *evm, const char *path){
+  cs_event_type_t names[CS_EVM_MAX_TYPES];
+  char *type_names[CS_EVM_MAX_TYPES];
+  int etids[CS_EVM_MAX_TYPES];
+  int header[2], i;
+  cs_trace_rec_t rec;
+  cs_event_t ev;
+  long int n = 0;
+  FILE *file;
+
+  if(!(file = fopen(path, "rb")) || fread(header, sizeof(int), 2, file)!=2 ||
+     header[0]!=CS_TRACE_MAGIC || header[1]!=CS_EV_INLINE_SIZE){
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_trace_replay(), %s is not a trace of this build", path);
+    if(file!=NULL)
+      fclose(file);
+    return -1;
+  }
+  memset(type_names, 0, sizeof(type_names));
+  memset(&ev, 0, sizeof(cs_event_t));
+
+  while(n>=0 && fread(&rec, sizeof(cs_trace_rec_t), 1, file)==1){
+    if(rec.size<0 || rec.size>CS_EV_INLINE_SIZE+CS_TRACE_PAGE ||
+       (rec.etid<0 && -rec.etid-1>=CS_EVM_MAX_TYPES) || rec.etid>=CS_EVM_MAX_TYPES){
+      n = -1;
+      break;
+    }
+    //a type: the ids of the trace are mapped to the ids of evm
+    if(rec.etid<0){
+      i = -rec.etid-1;
+      free(type_names[i]);
+      if(!(type_names[i] = (char *) malloc(rec.size)) ||
+	 fread(type_names[i], 1, rec.size, file)!=(size_t) rec.size){
+	n = -1;
+	break;
+      }
+      type_names[i][rec.size-1] = '\0';
+      //the types without handler in evm are skipped
+      if((etids[i] = _cs_evm_resolve_type(evm, type_names[i], 0))<0)
+	log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_WARN, "cs_evm_trace_replay(), no handler for the events %s", type_names[i]);
+      else
+	names[i] = evm->type_names[etids[i]];
+      continue;
+    }
+    if(type_names[rec.etid]==NULL || rec.size>CS_EV_INLINE_SIZE ||
+       (rec.size>0 && fread(ev.ev_inline, 1, rec.size, file)!=(size_t) rec.size)){
+      n = -1;
+      break;
+    }
+    if(etids[rec.etid]<0)
+      continue;
+    ev.etype = names[rec.etid];
+    ev.etid = etids[rec.etid];
+    ev.target = rec.target;
+    ev.ev_data = (rec.size>0 ? CS_EV_INLINE(&ev) : NULL);
+    ev.sched_at = -1;
+    _cs_evm_run_handler(evm, &ev, rec.at, 0, _cs_trace_drop, NULL);
+    n++;
+  }
+
+  if(n<0)
+    log4c_category_log(log4c_category_get("cs.events"), LOG4C_PRIORITY_ERROR, "cs_evm_trace_replay(), %s is corrupted", path);
+  for(i=0; i<CS_EVM_MAX_TYPES; i++)
+    free(type_names[i]);
+  fclose(file);
+  return n;
+}
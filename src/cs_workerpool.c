@@ -9,6 +9,8 @@ Redistribution and use in source and binary forms, with or without modification,
 THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#define _GNU_SOURCE //pthread_setaffinity_np
+
 #include "cs_workerpool.h"
 #include "cs_concurrence.h"
  
@@ -17,6 +19,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <sched.h>
 
 const char *status_str(cs_workerpool_status st){
   switch(st){
@@ -249,6 +252,7 @@ void cs_wp_destroy(cs_workerpool_t* wp)
 	int i = 0;
 	free(wp->name);
 	free(wp->wp_controller);
+	free(wp->cpus);
 	sem_destroy(wp->workerpool_semaphore);
 	free(wp->workerpool_semaphore);
 	//release data about workers
@@ -445,6 +449,22 @@ void *_cs_wp_worker_behaviour(void *args)
 	return NULL;
 }
 
+/*
+ * Internal function. Bind the thread to the cpus of the worker pool, if any.
+ */
+void _cs_wp_bind_thread(cs_workerpool_t *wp, pthread_t th)
+{
+	cpu_set_t set;
+	int i;
+	if(wp->ncpus==0)
+		return;
+	CPU_ZERO(&set);
+	for(i=0; i<wp->ncpus; i++)
+		CPU_SET(wp->cpus[i], &set);
+	if(pthread_setaffinity_np(th, sizeof(cpu_set_t), &set)!=0)
+		log4c_category_log(log4c_category_get("cs.workerpool"), LOG4C_PRIORITY_WARN,"Unable to bind a thread of %s to its cpus", wp->name);
+}
+
 /**
  * Internal function.
  * Create thread and start workers.
@@ -463,6 +483,7 @@ int _cs_wp_start_workers(cs_workerpool_t* wp)
 	      log4c_category_log(log4c_category_get("cs.workerpool"), LOG4C_PRIORITY_ERROR,"Unable to create worker %d", count);
 	      return -1;
 	    }
+	  _cs_wp_bind_thread(wp, *((wp->workers_data)[count]).th_id);
 	}
 	return 0;
 }
@@ -699,6 +720,34 @@ int cs_wp_tsk_queue_size(cs_workerpool_t* wp)
 	return cs_queue_size(wp->tsk_res_tb->tsk_q);
 }
 
+int cs_wp_tsk_queue_enable_stats(cs_workerpool_t* wp, short int enable)
+{
+	return cs_queue_enable_stats(wp->tsk_res_tb->tsk_q, enable);
+}
+
+int cs_wp_tsk_queue_stats(cs_workerpool_t* wp, cs_queue_stats_t *snapshot)
+{
+	return cs_queue_get_stats(wp->tsk_res_tb->tsk_q, snapshot);
+}
+
+int cs_wp_set_cpus(cs_workerpool_t* wp, const int *cpus, int ncpus)
+{
+	int *copy = NULL;
+	if(cs_wp_get_status(wp)!=CS_WPS_READY || ncpus<0 || (ncpus>0 && cpus==NULL)){
+		log4c_category_log(log4c_category_get("cs.workerpool"), LOG4C_PRIORITY_ERROR,"cs_wp_set_cpus(), the cpus must be set before starting %s", wp->name);
+		return -1;
+	}
+	if(ncpus>0){
+		if(!(copy = (int *) malloc(ncpus*sizeof(int))))
+			return -1;
+		memcpy(copy, cpus, ncpus*sizeof(int));
+	}
+	free(wp->cpus);
+	wp->cpus = copy;
+	wp->ncpus = ncpus;
+	return 0;
+}
+
 int cs_wp_start(cs_workerpool_t* wp)
 {
 	if(cs_wp_get_status(wp)!=CS_WPS_READY)
@@ -715,6 +764,7 @@ unable to initiate the WP-controller");
 		_UNLOCK_MUTEX(wp->wp_mutex);
 		return -1;
 	}
+	_cs_wp_bind_thread(wp, *wp->wp_controller);
 	_cs_wp_set_status(wp, CS_WPS_WORKING);
 	_UNLOCK_MUTEX(wp->wp_mutex);
 	return 0;
@@ -791,6 +841,8 @@ int cs_wp_init(int nthreads, int tsk_queue_size, cs_workerpool_t *wp, const char
 
 	/* the wp-controller */
 	wp->wp_controller = (pthread_t *) calloc(1, sizeof(pthread_t));
+	wp->cpus = NULL;
+	wp->ncpus = 0;
 
 	/* init the semaphore for workers coordination */
 	wp->workerpool_semaphore = (sem_t *) calloc(1, sizeof(sem_t));
@@ -0,0 +1,119 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "complex_sim.h"
+#include "cs_engine.h"
+
+#define NTASKS 2
+#define NTARGETS 10
+#define NPER 3
+#define NFREE 5
+#define NTICKS 20
+
+#define EV_ENTITY "ENTITY"
+#define EV_FREE "FREE"
+
+int task[NTARGETS]; //the task handling the events of a target
+int busy[NTARGETS];
+int scheduled[NTARGETS], handled[NTARGETS]; //the sequence numbers of the events of a target
+cs_clockv last[NTARGETS];
+int nfree = 0;
+
+/*
+* The events of a target are handled by the task of its mailbox, one
+* at a time, in the order they are scheduled; each event schedules the
+* next one for the next tick.
+*/
+cs_eh_status h_entity(cs_event_t *ev, cs_event_manager_t *evm){
+  long int t = ev->target;
+  int seq = *((int *) ev->ev_data);
+  cs_event_t *next;
+
+  assert(__sync_bool_compare_and_swap(&busy[t], 0, 1));
+  if(task[t]<0)
+    task[t] = _cs_evm_task_index(evm);
+  assert(task[t]==_cs_evm_task_index(evm) && task[t]==t%NTASKS);
+  assert(seq==handled[t]++);
+  assert(last[t]<=cs_evm_now(evm));
+  last[t] = cs_evm_now(evm);
+
+  if(cs_evm_now(evm)<NTICKS){
+    seq = scheduled[t]++;
+    next = cs_evm_alloc_event_data(EV_ENTITY, &seq, sizeof(int), evm);
+    next->target = t;
+    assert(cs_evm_schedule_event(next, cs_evm_now(evm)+1, evm)==0);
+  }
+  busy[t] = 0;
+  return CS_EH_NORMAL;
+}
+
+/* the events without target are shared by the tasks */
+cs_eh_status h_free(cs_event_t *ev, cs_event_manager_t *evm){
+  int index = _cs_evm_task_index(evm);
+  assert(ev->target<0 && index>=0 && index<NTASKS);
+  __sync_fetch_and_add(&nfree, 1);
+  if(cs_evm_now(evm)<NTICKS)
+    assert(cs_evm_schedule_event(cs_evm_alloc_event(EV_FREE, NULL, evm), cs_evm_now(evm)+1, evm)==0);
+  return CS_EH_NORMAL;
+}
+
+int main(int argc, char *argv[]){
+  cs_timer_t *timer;
+  cs_event_manager_t *evm;
+  cs_engine_t *engine;
+  cs_evm_conf_t conf;
+  cs_event_t *ev;
+  int i, k, seq;
+
+  log4c_init();
+
+  timer = (cs_timer_t*) calloc(1, sizeof(cs_timer_t));
+  cs_init_timer(timer, "CLOCK_TEST");
+  cs_evm_default_conf(&conf);
+  conf.affinity = 1;
+  evm = (cs_event_manager_t *) malloc(sizeof(cs_event_manager_t));
+  assert(cs_init_event_manager_conf(evm, NTASKS, timer, EVENT_DRIVEN, &conf)==0);
+  assert(cs_evm_install_handler(EV_ENTITY, h_entity, evm)==0);
+  assert(cs_evm_install_handler(EV_FREE, h_free, evm)==0);
+
+  //the events of the targets interleaved, and those without target
+  for(i=0; i<NTARGETS; i++)
+    task[i] = -1;
+  for(k=0; k<NPER; k++)
+    for(i=0; i<NTARGETS; i++){
+      seq = scheduled[i]++;
+      ev = cs_evm_alloc_event_data(EV_ENTITY, &seq, sizeof(int), evm);
+      ev->target = i;
+      assert(cs_evm_schedule_event(ev, 1, evm)==0);
+    }
+  for(k=0; k<NFREE; k++)
+    assert(cs_evm_schedule_event(cs_evm_alloc_event(EV_FREE, NULL, evm), 1, evm)==0);
+
+  engine = (cs_engine_t *) malloc(sizeof(cs_engine_t));
+  cs_init_engine(engine, 2);
+  cs_set_sim_type(engine, EVENT_DRIVEN);
+  cs_set_event_manager(engine, evm);
+  cs_set_timer(engine, timer);
+  cs_sim_start(engine);
+
+  for(i=0; i<NTARGETS; i++){
+    assert(handled[i]==NPER*NTICKS && scheduled[i]==handled[i]);
+    assert(task[i]==i%NTASKS && last[i]==NTICKS);
+  }
+  assert(nfree==NFREE*NTICKS);
+
+  log4c_fini();
+  return 0;
+}
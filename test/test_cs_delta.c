@@ -0,0 +1,157 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "complex_sim.h"
+#include "cs_engine.h"
+
+#define NA 8
+#define NCHAIN (CS_EVM_MAX_DELTA_CYCLES+10)
+#define K CS_EV_LIST_MIN_SIZE
+
+#define EV_A "A"
+#define EV_B "B"
+#define EV_CHAIN "CHAIN"
+#define EV_E "E"
+#define EV_F "F"
+
+/*
+* Fault injection: the first growth of an array after fail_grow 
+* is set fails, as it would without memory.
+*/
+extern void *__libc_realloc(void *ptr, size_t size);
+int fail_grow = 0, nfailed = 0;
+
+void *realloc(void *ptr, size_t size){
+  if(ptr!=NULL && __sync_bool_compare_and_swap(&fail_grow, 1, 0)){
+    nfailed++;
+    return NULL;
+  }
+  return __libc_realloc(ptr, size);
+}
+
+cs_timer_t *timer;
+int count_a = 0, count_b = 0;
+int chain_now = 0, chain_next = 0;
+int f_now = 0, f_next = 0;
+
+/* an event A schedules its event B at the current time */
+cs_eh_status h_a(cs_event_t *ev, cs_event_manager_t *evm){
+  __sync_fetch_and_add(&count_a, 1);
+  assert(cs_evm_schedule_event((cs_event_t *) ev->ev_data, cs_evm_now(evm), evm)==0);
+  return CS_EH_NORMAL;
+}
+
+/* the events B run in the same tick, after all the events A */
+cs_eh_status h_b(cs_event_t *ev, cs_event_manager_t *evm){
+  assert(cs_evm_now(evm)==5 && cs_get_clock(timer)==5);
+  assert(count_a==NA);
+  __sync_fetch_and_add(&count_b, 1);
+  return CS_EH_NORMAL;
+}
+
+/* a zero-delay loop, cut after CS_EVM_MAX_DELTA_CYCLES cycles */
+cs_eh_status h_chain(cs_event_t *ev, cs_event_manager_t *evm){
+  if(cs_evm_now(evm)==20)
+    chain_now++;
+  else if(cs_evm_now(evm)==21)
+    chain_next++;
+  if(chain_now+chain_next<NCHAIN)
+    assert(cs_evm_schedule_event(cs_evm_alloc_event(EV_CHAIN, NULL, evm), cs_evm_now(evm), evm)==0);
+  return CS_EH_NORMAL;
+}
+
+/* each task schedules an event F at the current time, then the next growth fails */
+cs_eh_status h_e(cs_event_t *ev, cs_event_manager_t *evm){
+  assert(cs_evm_schedule_event((cs_event_t *) ev->ev_data, cs_evm_now(evm), evm)==0);
+  fail_grow = 1;
+  return CS_EH_NORMAL;
+}
+
+cs_eh_status h_f(cs_event_t *ev, cs_event_manager_t *evm){
+  if(cs_evm_now(evm)==30)
+    __sync_fetch_and_add(&f_now, 1);
+  else if(cs_evm_now(evm)==31)
+    __sync_fetch_and_add(&f_next, 1);
+  return CS_EH_NORMAL;
+}
+
+void run(cs_event_manager_t *evm){
+  cs_engine_t *engine = (cs_engine_t *) malloc(sizeof(cs_engine_t));
+  cs_init_engine(engine, 2);
+  cs_set_sim_type(engine, EVENT_DRIVEN);
+  cs_set_event_manager(engine, evm);
+  cs_set_timer(engine, timer);
+  cs_sim_start(engine);
+}
+
+int main(int argc, char *argv[]){
+  cs_event_manager_t *evm;
+  cs_evm_conf_t conf;
+  cs_event_t *as = CS_NEW_EVENT(NA), *bs = CS_NEW_EVENT(NA);
+  cs_event_t *es = CS_NEW_EVENT(2*K), *fs = CS_NEW_EVENT(2*K);
+  int i;
+
+  log4c_init();
+
+  /* The events scheduled at the current time, and a zero-delay loop */
+  timer = (cs_timer_t*) calloc(1, sizeof(cs_timer_t));
+  cs_init_timer(timer, "CLOCK_TEST");
+  evm = (cs_event_manager_t *) malloc(sizeof(cs_event_manager_t));
+  assert(cs_init_event_manager(evm, 3, timer, EVENT_DRIVEN)==0);
+  assert(cs_evm_install_handler(EV_A, h_a, evm)==0);
+  assert(cs_evm_install_handler(EV_B, h_b, evm)==0);
+  assert(cs_evm_install_handler(EV_CHAIN, h_chain, evm)==0);
+  for(i=0; i<NA; i++){
+    as[i].etype = EV_A;
+    as[i].ev_data = &bs[i];
+    bs[i].etype = EV_B;
+    assert(cs_evm_schedule_event(&as[i], 5, evm)==0);
+  }
+  assert(cs_evm_schedule_event(cs_evm_alloc_event(EV_CHAIN, NULL, evm), 20, evm)==0);
+  run(evm);
+
+  assert(count_a==NA && count_b==NA);
+  //the rest of the loop is deferred to the next tick
+  assert(chain_now==CS_EVM_MAX_DELTA_CYCLES && chain_next==NCHAIN-CS_EVM_MAX_DELTA_CYCLES);
+
+  /* 
+  * With affinity the tasks fill their delta lists, two tasks of K 
+  * events each: gathering the second list fails, and its events are
+  * deferred to the next tick.
+  */
+  timer = (cs_timer_t*) calloc(1, sizeof(cs_timer_t));
+  cs_init_timer(timer, "CLOCK_TEST");
+  cs_evm_default_conf(&conf);
+  conf.affinity = 1;
+  evm = (cs_event_manager_t *) malloc(sizeof(cs_event_manager_t));
+  assert(cs_init_event_manager_conf(evm, 2, timer, EVENT_DRIVEN, &conf)==0);
+  assert(cs_evm_install_handler(EV_E, h_e, evm)==0);
+  assert(cs_evm_install_handler(EV_F, h_f, evm)==0);
+  for(i=0; i<2*K; i++){
+    es[i].etype = EV_E;
+    es[i].target = i;
+    es[i].ev_data = &fs[i];
+    fs[i].etype = EV_F;
+    fs[i].target = i;
+    assert(cs_evm_schedule_event(&es[i], 30, evm)==0);
+  }
+  run(evm);
+
+  assert(nfailed==1);
+  assert(f_now==K && f_next==K);
+
+  log4c_fini();
+  return 0;
+}
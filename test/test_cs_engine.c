@@ -120,6 +120,8 @@ void test_engine(sim_type_t st){
   cs_event_type_t t2 = "T2";
 
   cs_event_t ev1, ev2;
+  cs_ev_init(&ev1);
+  cs_ev_init(&ev2);
   ev1.ev_data = "D1";
   ev2.ev_data = "D2";
   ev1.etype = t1;
@@ -14,6 +14,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include "complex_sim.h"
 #include "cs_psk.h"
 #include "cs_events.h"
+#include "cs_evstats.h"
 
 cs_eh_status h_t1(cs_event_t *ev){
   log4c_category_log(log4c_category_get("cs.test"), LOG4C_PRIORITY_NOTICE, "handler_t1(), v=%s", (const char *) ev->ev_data);
@@ -25,6 +26,83 @@ cs_eh_status h_t2(cs_event_t *ev){
   return CS_EH_NORMAL;
 }
 
+int batch_calls = 0, batch_events = 0;
+int timeouts = 0, beats = 0;
+
+cs_eh_status h_beat(cs_event_t *ev){
+  beats++;
+  return CS_EH_NORMAL;
+}
+
+cs_eh_status h_timeout(cs_event_t *ev){
+  timeouts++;
+  return CS_EH_NORMAL;
+}
+
+/* a timeout raised once more at the same time, by a new handle */
+cs_ev_handle_t rearm_h;
+int rearms = 0;
+
+cs_eh_status h_rearm(cs_event_t *ev, cs_event_manager_t *evm){
+  if(rearms++==0)
+    assert(cs_evm_schedule_event_handle(ev, rearm_h.at, evm, &rearm_h)==0);
+  return CS_EH_NORMAL;
+}
+
+cs_eh_status h_batch(cs_event_t **evs, size_t n, cs_event_manager_t *evm){
+  size_t i;
+  batch_calls++;
+  for(i=0; i<n; i++){
+    assert(CS_EV_IS_TYPE(evs[i], "T2"));
+    batch_events++;
+  }
+  return CS_EH_NORMAL;
+}
+
+/* the order of the handlers of an event, and the targets of the broadcasts */
+char order[16];
+int norder = 0;
+long int bcast_sum = 0;
+int bcast_seen = 0;
+
+cs_eh_status h_main(cs_event_t *ev){ order[norder++] = 'M'; return CS_EH_NORMAL; }
+cs_eh_status s_a(cs_event_t *ev){ order[norder++] = 'A'; return CS_EH_NORMAL; }
+cs_eh_status s_b(cs_event_t *ev){ order[norder++] = 'B'; return CS_EH_NORMAL; }
+cs_eh_status s_c(cs_event_t *ev){ order[norder++] = 'C'; return CS_EH_NORMAL; }
+cs_eh_status s_d(cs_event_t *ev){ order[norder++] = 'D'; return CS_EH_NORMAL; }
+
+/* the order of the events of a sorted tick */
+cs_event_t *sorted[8];
+int nsorted = 0;
+
+cs_eh_status h_sorted(cs_event_t *ev){ sorted[nsorted++] = ev; return CS_EH_NORMAL; }
+
+cs_eh_status h_bcast(cs_event_t *ev){
+  bcast_sum+=cs_ev_target(ev);
+  return CS_EH_NORMAL;
+}
+
+cs_eh_status s_bcast(cs_event_t *ev){
+  bcast_seen++;
+  return CS_EH_NORMAL;
+}
+
+#define NINSTALLS 100
+char install_names[NINSTALLS][8];
+
+/*
+* Install handlers of new types while the main thread looks them up.
+*/
+void *installer(void *arg){
+  cs_event_manager_t *evm = arg;
+  int i;
+  for(i=0; i<NINSTALLS; i++){
+    sprintf(install_names[i], "N%d", i);
+    assert(cs_evm_install_handler(install_names[i], (cs_event_handler_t) h_t2, evm)==0);
+  }
+  return NULL;
+}
+
 int main(int argc, char *argv[]){
 
   log4c_init();
@@ -37,6 +115,8 @@ int main(int argc, char *argv[]){
   cs_event_type_t t2 = "T2";
 
   cs_event_t ev1, ev2;
+  cs_ev_init(&ev1);
+  cs_ev_init(&ev2);
   ev1.ev_data = "D1";
   ev2.ev_data = "D2";
   ev1.etype = t1;
@@ -48,8 +128,49 @@ int main(int argc, char *argv[]){
 
   /* Handler T1,T2 */
   assert(cs_evm_install_handler(t1, h_t1, &evm)==0);
+
+  /* Pooled events are recycled */
+  cs_event_t *pev = cs_evm_alloc_event(t2, "P", &evm);
+  assert(pev!=NULL && pev->etype==t2 && pev->pending==0);
+  cs_evm_free_event(pev, &evm);
+  assert(cs_evm_alloc_event(t1, NULL, &evm)==pev);
+  cs_evm_free_event(pev, &evm);
+
+  /* Small payloads are stored in the event, large ones apart */
+  char small[CS_EV_INLINE_SIZE] = "small", large[CS_EV_INLINE_SIZE+1] = "large";
+  pev = cs_evm_alloc_event_data(t1, small, sizeof(small), &evm);
+  assert(CS_EV_DATA_IS_INLINE(pev) && strcmp(pev->ev_data, "small")==0);
+  cs_evm_free_event(pev, &evm);
+  pev = cs_evm_alloc_event_data(t1, large, sizeof(large), &evm);
+  assert(!CS_EV_DATA_IS_INLINE(pev) && strcmp(pev->ev_data, "large")==0);
+  cs_evm_free_event(pev, &evm);
   assert(cs_evm_install_handler(t2, h_t2, &evm)==0);
 
+  /* Types are interned: the same name (at any address) gets the same id */
+  char t1_copy[] = "T1";
+  assert(cs_evm_register_type(t1, &evm) == cs_evm_register_type(t1_copy, &evm));
+  assert(cs_evm_register_type(t1, &evm) != cs_evm_register_type(t2, &evm));
+  assert(strcmp(cs_evm_type_name(cs_evm_register_type(t2, &evm), &evm), "T2")==0);
+  assert(cs_evm_type_name(CS_EVM_MAX_TYPES-1, &evm)==NULL);
+  assert(cs_evm_get_handler(t1_copy, &evm) == (cs_event_handler_t) h_t1);
+  assert(cs_evm_install_handler(t1, (cs_event_handler_t) h_t2, &evm)==0);
+  assert(cs_evm_get_handler(t1, &evm) == (cs_event_handler_t) h_t2);
+  assert(cs_evm_install_handler(t1, (cs_event_handler_t) h_t1, &evm)==0);
+
+  /* The lookups of the handlers do not wait for the installs */
+  pthread_t th;
+  char names[NINSTALLS][8], t2_copy[] = "T2";
+  int n;
+  assert(pthread_create(&th, NULL, installer, &evm)==0);
+  for(n=0; n<100000; n++)
+    assert(cs_evm_get_handler((n%2 ? t1_copy : t2_copy), &evm) == (cs_event_handler_t) (n%2 ? h_t1 : h_t2));
+  pthread_join(th, NULL);
+  for(n=0; n<NINSTALLS; n++){
+    sprintf(names[n], "N%d", n);
+    assert(cs_evm_get_handler(names[n], &evm) == (cs_event_handler_t) h_t2);
+    assert(strcmp(cs_evm_type_name(cs_evm_register_type(names[n], &evm), &evm), names[n])==0);
+  }
+
   /* Scheduling of some eventss */
   assert(cs_evm_schedule_event(&ev1, (cs_clockv) 2, &evm)==0);
   assert(cs_evm_num_events(&evm) == 1);
@@ -68,6 +189,153 @@ int main(int argc, char *argv[]){
   cs_time_sync(clock); //clock == 3, nothing should happen
   cs_time_sync(clock); //clock == 4, should raise event ev2
 
+  /* T2 events are grouped and passed to the batch handler */
+  int i;
+  cs_event_t evb[10];
+  assert(cs_evm_install_batch_handler(t2, h_batch, &evm)==0);
+  for(i=0; i<10; i++){
+    cs_ev_init(&evb[i]);
+    evb[i].etype = (i%2 ? t1 : t2);
+    evb[i].ev_data = "B";
+    assert(cs_evm_schedule_event(&evb[i], (cs_clockv) 100, &evm)==0);
+  }
+  assert(cs_evm_num_events(&evm)==10);
+  assert(cs_evm_throw_scheduled_events(&evm, (cs_clockv) 100)==10);
+  assert(cs_evm_num_events(&evm)==0 && !cs_evm_more_events(&evm));
+  assert(batch_calls==1 && batch_events==5);
+  assert(cs_evm_install_batch_handler(t2, NULL, &evm)==0);
+
+  /* Schedules by handle are cancelled or moved, leaving tombstones */
+  cs_ev_handle_t h;
+  assert(cs_evm_install_handler("TO", (cs_event_handler_t) h_timeout, &evm)==0);
+  pev = cs_evm_alloc_event("TO", NULL, &evm);
+  assert(cs_evm_schedule_event_handle(pev, (cs_clockv) 200, &evm, &h)==0);
+  assert(cs_evm_schedule_event_handle(pev, (cs_clockv) 201, &evm, &h)<0);
+  assert(cs_evm_schedule_event(pev, (cs_clockv) 201, &evm)<0);
+  assert(cs_evm_cancel(&h, &evm)==0);
+  assert(cs_evm_cancel(&h, &evm)<0);
+  cs_evm_throw_scheduled_events(&evm, (cs_clockv) 200);
+  assert(timeouts==0);
+  pev = cs_evm_alloc_event("TO", NULL, &evm);
+  assert(cs_evm_schedule_event_handle(pev, (cs_clockv) 300, &evm, &h)==0);
+  assert(cs_evm_reschedule(&h, (cs_clockv) 250, &evm)==0 && h.at==250);
+  cs_evm_throw_scheduled_events(&evm, (cs_clockv) 250);
+  assert(timeouts==1);
+  assert(cs_evm_cancel(&h, &evm)<0); //already raised
+  cs_evm_throw_scheduled_events(&evm, (cs_clockv) 300);
+  assert(timeouts==1);
+  cs_ev_handle_t stale;
+  assert(cs_evm_install_handler("RE", h_rearm, &evm)==0);
+  pev = cs_evm_alloc_event("RE", NULL, &evm);
+  assert(cs_evm_schedule_event_handle(pev, (cs_clockv) 350, &evm, &stale)==0);
+  rearm_h = stale;
+  cs_evm_throw_scheduled_events(&evm, (cs_clockv) 350);
+  assert(rearms==1 && rearm_h.at==350);
+  assert(cs_evm_cancel(&stale, &evm)<0); //the new schedule stays live
+  assert(cs_evm_cancel(&rearm_h, &evm)==0);
+  cs_evm_throw_scheduled_events(&evm, (cs_clockv) 350);
+  assert(rearms==1);
+
+  /* Periodic events are raised by the timing wheel */
+  assert(cs_evm_install_handler("BEAT", (cs_event_handler_t) h_beat, &evm)==0);
+  pev = cs_evm_alloc_event("BEAT", NULL, &evm);
+  assert(cs_evm_schedule_periodic(pev, (cs_clockv) 400, (cs_clockv) 10, 3, &evm)==0);
+  assert(cs_evm_num_events(&evm)==1 && cs_evm_find_nearest_events(&evm)==400);
+  assert(cs_evm_find_farthest_events(&evm)==400); //held by the wheel only
+  for(i=400; i<=430; i+=10)
+    cs_evm_throw_scheduled_events(&evm, (cs_clockv) i);
+  assert(beats==3 && cs_evm_num_events(&evm)==0);
+  pev = cs_evm_alloc_event("BEAT", NULL, &evm);
+  assert(cs_evm_schedule_periodic(pev, (cs_clockv) 500, (cs_clockv) 300, -1, &evm)==0);
+  cs_evm_throw_scheduled_events(&evm, (cs_clockv) 500);
+  assert(beats==4 && cs_evm_find_nearest_events(&evm)==800 && cs_evm_find_farthest_events(&evm)==800);
+  cs_evm_stop_periodic(pev, &evm);
+  cs_evm_throw_scheduled_events(&evm, (cs_clockv) 800);
+  assert(beats==4 && cs_evm_num_events(&evm)==0);
+
+  /* Subscribers run around the handler, by priority */
+  cs_event_t evo;
+  cs_ev_init(&evo);
+  assert(cs_evm_install_handler("OBS", (cs_event_handler_t) h_main, &evm)==0);
+  assert(cs_evm_subscribe("OBS", (cs_event_handler_t) s_b, 5, &evm)==0);
+  assert(cs_evm_subscribe("OBS", (cs_event_handler_t) s_a, -1, &evm)==0);
+  assert(cs_evm_subscribe("OBS", (cs_event_handler_t) s_c, 5, &evm)==0);
+  assert(cs_evm_subscribe("OBS", (cs_event_handler_t) s_d, 0, &evm)==0);
+  assert(cs_evm_subscribe("OBS", (cs_event_handler_t) s_d, 1, &evm)<0);
+  evo.etype = "OBS";
+  assert(cs_evm_throw_event(&evm, &evo)==CS_EH_NORMAL);
+  assert(norder==5 && strncmp(order, "AMDBC", 5)==0);
+  assert(cs_evm_unsubscribe("OBS", (cs_event_handler_t) s_b, &evm)==0);
+  assert(cs_evm_unsubscribe("OBS", (cs_event_handler_t) s_b, &evm)<0);
+  assert(cs_evm_install_handler("OBS", NULL, &evm)==0);
+  norder = 0;
+  assert(cs_evm_throw_event(&evm, &evo)==CS_EH_NORMAL);
+  assert(norder==3 && strncmp(order, "ADC", 3)==0);
+
+  /* A broadcast delivers one event to each target */
+  long int targets[3] = {3, 5, 7};
+  assert(cs_evm_install_handler("BC", (cs_event_handler_t) h_bcast, &evm)==0);
+  assert(cs_evm_subscribe("BC", (cs_event_handler_t) s_bcast, 1, &evm)==0);
+  pev = cs_evm_alloc_event("BC", NULL, &evm);
+  assert(cs_evm_schedule_broadcast(pev, (cs_clockv) 1000, targets, 3, &evm)==0);
+  assert(pev->pending==1 && cs_evm_num_events(&evm)==1);
+  assert(cs_evm_throw_scheduled_events(&evm, (cs_clockv) 1000)==1);
+  assert(bcast_sum==15 && bcast_seen==3);
+  assert(pev->etype==NULL && cs_evm_num_events(&evm)==0); //back to the pool
+
+  /* Counters of the event types, merged on snapshot */
+  cs_evm_type_stats_t st;
+  cs_event_t evs[3];
+  assert(cs_evm_type_stats(&evm, "BEAT", &st)<0);
+  assert(cs_evm_enable_type_stats(&evm, 1)==0);
+  assert(cs_evm_type_stats(&evm, "NONE", &st)<0);
+  for(i=0; i<3; i++){
+    cs_ev_init(&evs[i]);
+    evs[i].etype = "BEAT";
+    assert(cs_evm_schedule_event(&evs[i], (cs_clockv) 900+i, &evm)==0);
+  }
+  cs_evm_throw_scheduled_events(&evm, (cs_clockv) 900);
+  cs_evm_throw_scheduled_events(&evm, (cs_clockv) 901);
+  assert(cs_evm_type_stats(&evm, "BEAT", &st)==0);
+  assert(st.scheduled==3 && st.thrown==2 && st.latency.samples==2 && st.handler_ns==st.latency.sum);
+  assert(cs_evm_enable_type_stats(&evm, 0)==0);
+  cs_evm_throw_scheduled_events(&evm, (cs_clockv) 902);
+  assert(beats==7 && cs_evm_type_stats(&evm, "BEAT", &st)<0);
+  assert(cs_evm_enable_type_stats(&evm, 1)==0);
+  assert(cs_evm_type_stats(&evm, "BEAT", &st)==0 && st.thrown==2);
+  cs_evm_reset_type_stats(&evm);
+  assert(cs_evm_type_stats(&evm, "BEAT", &st)==0 && st.thrown==0 && st.scheduled==0);
+  //a broadcast counts its deliveries only
+  pev = cs_evm_alloc_event("BC", NULL, &evm);
+  assert(cs_evm_schedule_broadcast(pev, (cs_clockv) 950, targets, 3, &evm)==0);
+  assert(cs_evm_throw_scheduled_events(&evm, (cs_clockv) 950)==1);
+  assert(cs_evm_type_stats(&evm, "BC", &st)==0 && st.thrown==3 && st.latency.samples==3);
+  assert(cs_evm_type_stats(&evm, "CS_BROADCAST", &st)==0 && st.thrown==0 && st.scheduled==0 && st.handler_ns==0);
+
+  /* The events of a sorted tick are handled by priority of their type, type and target */
+  cs_event_manager_t sevm;
+  cs_evm_conf_t conf;
+  cs_event_t sev[6];
+  long int stargets[6] = {300, 4, -1, 300, 2, 4};
+  int expected[6] = {4, 1, 2, 5, 0, 3};
+  cs_evm_default_conf(&conf);
+  conf.sort_ticks = 1;
+  assert(cs_init_event_manager_conf(&sevm, 2, clock, ACTIVITY_SCAN, &conf)==0);
+  assert(cs_evm_install_handler("SX", (cs_event_handler_t) h_sorted, &sevm)==0);
+  assert(cs_evm_install_handler("SY", (cs_event_handler_t) h_sorted, &sevm)==0);
+  assert(cs_evm_set_type_priority("SY", -1, &sevm)==0);
+  assert(cs_evm_set_type_priority("SY", CS_EVM_MAX_PRIORITY+1, &sevm)<0);
+  for(i=0; i<6; i++){
+    cs_ev_init(&sev[i]);
+    sev[i].etype = (i%3==1 || i==4 ? "SY" : "SX");
+    sev[i].target = stargets[i];
+    assert(cs_evm_schedule_event(&sev[i], (cs_clockv) 10, &sevm)==0);
+  }
+  assert(cs_evm_throw_scheduled_events(&sevm, (cs_clockv) 10)==6);
+  for(i=0; i<6; i++)
+    assert(sorted[i]==&sev[expected[i]]);
+  cs_destroy_event_manager(&sevm);
+
   cs_evm_stop_controller(&evm);
   cs_time_stop(clock);
 
@@ -0,0 +1,115 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "complex_sim.h"
+#include "cs_engine.h"
+#include "cs_evgroup.h"
+#include "cs_timewarp.h"
+
+#define NMEMBERS 2
+#define NENTITIES 64
+#define NMSG 1000
+#define TTL 30
+
+#define EV_HOP "HOP"
+
+typedef struct hop_s{
+  int hops;
+  cs_clockv at; //the time the event is expected at
+}hop_t;
+
+cs_evm_group_t group;
+int busy[NENTITIES];
+long int handled = 0, remote = 0, refused = 0;
+
+/*
+* A message hopping between entities, owned by both the members.
+*/
+cs_eh_status h_hop(cs_event_t *ev, cs_event_manager_t *evm){
+  hop_t *h = ev->ev_data;
+  long int e = ev->target, next;
+  cs_clockv now = cs_evm_now(evm);
+
+  assert(now==h->at);
+  assert(cs_evm_group_member(&group, e)==evm); //handled by the owner
+  assert(__sync_fetch_and_add(&busy[e], 1)==0);
+  __sync_fetch_and_add(&handled, 1);
+
+  if(++h->hops<TTL){
+    next = (e*7+h->hops)%NENTITIES;
+    if(cs_evm_group_member(&group, next)!=evm){
+      __sync_fetch_and_add(&remote, 1);
+      //another member may be done with the current tick
+      CS_EV_SET_TARGET(ev, next);
+      if(h->hops==1 && e==0 && cs_evm_schedule_event(ev, now, evm)<0)
+	__sync_fetch_and_add(&refused, 1);
+    }
+    h->at = now+1+rand()%3;
+    CS_EV_SET_TARGET(ev, next);
+    assert(cs_evm_schedule_event(ev, h->at, evm)==0);
+  }
+  __sync_fetch_and_sub(&busy[e], 1);
+  return CS_EH_NORMAL;
+}
+
+int main(int argc, char *argv[]){
+  cs_timer_t *timer;
+  cs_engine_t *engine;
+  cs_event_manager_t *evm;
+  cs_evm_conf_t conf;
+  cs_event_t *ev;
+  hop_t h;
+  int i;
+
+  log4c_init();
+  srand(1);
+
+  timer = (cs_timer_t*) calloc(1, sizeof(cs_timer_t));
+  cs_init_timer(timer, "CLOCK_TEST");
+
+  //the events of an entity are handled one at a time
+  cs_evm_default_conf(&conf);
+  conf.affinity = 1;
+  assert(cs_evm_group_init(&group, NMEMBERS, 4, timer, EVENT_DRIVEN, &conf)==0);
+  assert(cs_evm_group_install_handler(&group, EV_HOP, h_hop)==0);
+  assert(cs_evm_enable_timewarp(&group.members[0], 10, NULL, NULL, NULL, NULL)<0);
+
+  //all the messages are scheduled on the first member, and routed by target
+  evm = cs_evm_group_member(&group, 0);
+  for(i=0; i<NMSG; i++){
+    h.hops = 0;
+    h.at = 1+rand()%5;
+    ev = cs_evm_alloc_event_data(EV_HOP, &h, sizeof(hop_t), evm);
+    CS_EV_SET_TARGET(ev, i%NENTITIES);
+    assert(cs_evm_schedule_event(ev, h.at, evm)==0);
+  }
+  assert(cs_evm_num_events(&group.members[1])==NMSG/2);
+  assert(cs_evm_group_num_events(&group)==NMSG);
+
+  engine = (cs_engine_t *) malloc(sizeof(cs_engine_t));
+  cs_init_engine(engine, 2);
+  cs_set_sim_type(engine, EVENT_DRIVEN);
+  cs_set_event_group(engine, &group);
+  cs_set_timer(engine, timer);
+  cs_sim_start(engine);
+
+  assert(handled==NMSG*TTL);
+  assert(remote>0 && refused>0);
+  assert(cs_evm_group_num_events(&group)==0);
+
+  cs_evm_group_destroy(&group);
+  log4c_fini();
+  return 0;
+}
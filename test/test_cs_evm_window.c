@@ -0,0 +1,121 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "complex_sim.h"
+#include "cs_engine.h"
+
+#define NENTITIES 64
+#define NMSG 1000
+#define TTL 30
+#define LOOKAHEAD 10
+
+#define EV_HOP "HOP"
+#define EV_LOG "LOG"
+
+typedef struct hop_s{
+  int hops;
+  cs_clockv at; //the time the event is expected at
+}hop_t;
+
+/* per entity: the time of the last event, and whether it is being handled */
+cs_clockv last[NENTITIES];
+int busy[NENTITIES];
+cs_clockv last_log = -1;
+long int handled = 0, logged = 0;
+
+/*
+* A message hopping between entities, with a delay of at least LOOKAHEAD.
+*/
+cs_eh_status h_hop(cs_event_t *ev, cs_event_manager_t *evm){
+  hop_t *h = ev->ev_data;
+  long int e = ev->target;
+  cs_clockv now = cs_evm_now(evm);
+  cs_event_t *log_ev;
+
+  assert(now==h->at);
+  assert(__sync_fetch_and_add(&busy[e], 1)==0); //no concurrent events for an entity
+  assert(now>=last[e]);
+  last[e] = now;
+  __sync_fetch_and_add(&handled, 1);
+
+  if(++h->hops<TTL){
+    h->at = now+LOOKAHEAD+rand()%5;
+    CS_EV_SET_TARGET(ev, (e*7+h->hops)%NENTITIES);
+    assert(cs_evm_schedule_event(ev, h->at, evm)==0);
+  }
+  else{
+    log_ev = cs_evm_alloc_event_data(EV_LOG, h, sizeof(hop_t), evm);
+    ((hop_t *) log_ev->ev_data)->at = now+LOOKAHEAD;
+    assert(cs_evm_schedule_event(log_ev, now+LOOKAHEAD, evm)==0);
+  }
+  __sync_fetch_and_sub(&busy[e], 1);
+  return CS_EH_NORMAL;
+}
+
+/*
+* Events without target: handled by a single worker, in time order.
+*/
+cs_eh_status h_log(cs_event_t *ev, cs_event_manager_t *evm){
+  cs_clockv now = cs_evm_now(evm);
+  assert(now==((hop_t *) ev->ev_data)->at);
+  assert(now>=last_log);
+  last_log = now;
+  logged++;
+  return CS_EH_NORMAL;
+}
+
+int main(int argc, char *argv[]){
+  cs_timer_t *timer;
+  cs_event_manager_t *evm;
+  cs_engine_t *engine;
+  cs_evm_conf_t conf;
+  cs_event_t *ev;
+  hop_t h;
+  int i;
+
+  log4c_init();
+  srand(1);
+
+  timer = (cs_timer_t*) calloc(1, sizeof(cs_timer_t));
+  cs_init_timer(timer, "CLOCK_TEST");
+
+  evm = (cs_event_manager_t *) malloc(sizeof(cs_event_manager_t));
+  cs_evm_default_conf(&conf);
+  conf.lookahead = LOOKAHEAD;
+  assert(cs_init_event_manager_conf(evm, 8, timer, EVENT_DRIVEN, &conf)==0);
+  assert(cs_evm_install_handler(EV_HOP, h_hop, evm)==0);
+  assert(cs_evm_install_handler(EV_LOG, h_log, evm)==0);
+
+  for(i=0; i<NMSG; i++){
+    h.hops = 0;
+    h.at = 1+rand()%LOOKAHEAD;
+    ev = cs_evm_alloc_event_data(EV_HOP, &h, sizeof(hop_t), evm);
+    CS_EV_SET_TARGET(ev, i%NENTITIES);
+    assert(cs_evm_schedule_event(ev, h.at, evm)==0);
+  }
+
+  engine = (cs_engine_t *) malloc(sizeof(cs_engine_t));
+  cs_init_engine(engine, 2);
+  cs_set_sim_type(engine, EVENT_DRIVEN);
+  cs_set_event_manager(engine, evm);
+  cs_set_timer(engine, timer);
+  cs_sim_start(engine);
+
+  assert(handled==NMSG*TTL);
+  assert(logged==NMSG);
+
+  log4c_fini();
+  return 0;
+}
@@ -0,0 +1,93 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "complex_sim.h"
+#include "cs_events.h"
+#include "cs_evstore.h"
+
+#define NLISTS 5000
+#define MAX_TIME 100000
+
+/*
+* Insert NLISTS lists with random (distinct) scheduling times, 
+* then pop them in order through cs_evstore_first().
+*/
+void test_store(cs_evstore_type type){
+  cs_evstore_t *st;
+  cs_event_list_t *list, *prev = NULL;
+  char *used = calloc(MAX_TIME, sizeof(char));
+  cs_clockv at;
+  int i, n = 0;
+
+  assert((st = cs_evstore_create(type))!=NULL);
+  assert(cs_evstore_first(st)==NULL);
+
+  for(i=0; i<NLISTS; i++){
+    /* a dense window, plus some far-future outliers */
+    at = (i%10==0 ? rand()%MAX_TIME : rand()%1000);
+    if(used[at])
+      continue;
+    used[at] = 1;
+    list = calloc(1, sizeof(cs_event_list_t));
+    list->scheduled_at = at;
+    assert(cs_evstore_insert(st, list)==0);
+    assert(cs_evstore_find(st, at)==list);
+    n++;
+  }
+  assert(cs_evstore_count(st)==n);
+  assert(cs_evstore_find(st, MAX_TIME)==NULL);
+
+  /* remove half of the lists by time */
+  for(at=0; at<MAX_TIME; at+=2)
+    if(used[at]){
+      assert((list = cs_evstore_remove(st, at))!=NULL && list->scheduled_at==at);
+      assert(cs_evstore_find(st, at)==NULL);
+      free(list);
+      used[at] = 0;
+      n--;
+    }
+  assert(cs_evstore_count(st)==n);
+  assert(cs_evstore_last(st)->scheduled_at%2==1);
+
+  /* pop-min, interleaved with insertions in the future */
+  while((list = cs_evstore_first(st))!=NULL){
+    assert(prev==NULL || list->scheduled_at>prev->scheduled_at);
+    assert(cs_evstore_remove(st, list->scheduled_at)==list);
+    free(prev);
+    prev = list;
+    if(n%7==0 && !used[(list->scheduled_at+3)%MAX_TIME] && list->scheduled_at+3<MAX_TIME){
+      list = calloc(1, sizeof(cs_event_list_t));
+      list->scheduled_at = prev->scheduled_at+3;
+      used[list->scheduled_at] = 1;
+      assert(cs_evstore_insert(st, list)==0);
+      n++;
+    }
+    n--;
+  }
+  assert(n==0 && cs_evstore_count(st)==0);
+
+  free(prev);
+  free(used);
+  cs_evstore_destroy(st, NULL);
+}
+
+int main(int argc, char *argv[]){
+  log4c_init();
+  srand(1);
+  test_store(CS_EVSTORE_RBTREE);
+  test_store(CS_EVSTORE_CALENDAR);
+  log4c_fini();
+  return 0;
+}
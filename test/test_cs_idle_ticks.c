@@ -0,0 +1,89 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "complex_sim.h"
+#include "cs_engine.h"
+
+#define EV_WAKE "WAKE"
+#define NWAKES 3
+
+/* a sparse schedule, and the times the events are handled at */
+cs_clockv wakes[NWAKES] = {3, 50, 400};
+cs_clockv seen[NWAKES];
+int nseen = 0;
+cs_timer_t *timer;
+
+cs_eh_status h_wake(cs_event_t *ev, cs_event_manager_t *evm){
+  assert(cs_evm_now(evm)==cs_get_clock(timer));
+  seen[nseen++] = cs_evm_now(evm);
+  return CS_EH_NORMAL;
+}
+
+/*
+* Run the sparse schedule, skipping the idle ticks or not.
+* @return the steps of the engine.
+*/
+long int run(int skip){
+  cs_event_manager_t *evm;
+  cs_engine_t *engine;
+  cs_event_t *evs = CS_NEW_EVENT(NWAKES);
+  int i;
+
+  timer = (cs_timer_t*) calloc(1, sizeof(cs_timer_t));
+  cs_init_timer(timer, "CLOCK_TEST");
+  evm = (cs_event_manager_t *) malloc(sizeof(cs_event_manager_t));
+  assert(cs_init_event_manager(evm, 2, timer, EVENT_DRIVEN)==0);
+  assert(cs_evm_install_handler(EV_WAKE, h_wake, evm)==0);
+  for(i=0; i<NWAKES; i++){
+    evs[i].etype = EV_WAKE;
+    assert(cs_evm_schedule_event(&evs[i], wakes[i], evm)==0);
+  }
+
+  engine = (cs_engine_t *) malloc(sizeof(cs_engine_t));
+  cs_init_engine(engine, 2);
+  cs_set_sim_type(engine, EVENT_DRIVEN);
+  cs_set_event_manager(engine, evm);
+  cs_set_timer(engine, timer);
+  cs_set_skip_idle_ticks(engine, skip);
+  nseen = 0;
+  cs_sim_start(engine);
+
+  //the controller handles each event at its time either way
+  assert(nseen==NWAKES);
+  for(i=0; i<NWAKES; i++)
+    assert(seen[i]==wakes[i]);
+  assert(cs_get_clock(timer)==wakes[NWAKES-1]+1);
+  return engine->steps;
+}
+
+int main(int argc, char *argv[]){
+  cs_timer_t t;
+
+  log4c_init();
+
+  /* The clock goes to the earliest time proposed, at least to the next tick */
+  cs_init_timer(&t, "SYNC_TEST");
+  cs_set_nsync(&t, 1);
+  assert(cs_time_sync_to(&t, 10)==0 && cs_get_clock(&t)==10);
+  assert(cs_time_sync_to(&t, 5)==0 && cs_get_clock(&t)==11);
+  assert(cs_time_sync(&t)==0 && cs_get_clock(&t)==12);
+
+  /* The engine steps on the ticks of the events only, or on every tick */
+  assert(run(1)==NWAKES);
+  assert(run(0)==wakes[NWAKES-1]);
+
+  log4c_fini();
+  return 0;
+}
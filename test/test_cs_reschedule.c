@@ -0,0 +1,109 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "complex_sim.h"
+#include "cs_engine.h"
+
+#define NTASKS 2
+#define NPAIRS 16
+#define NROUNDS 50
+
+#define EV_TIMER "TIMER"
+#define EV_KICK "KICK"
+
+/* a round of a pair: its timer is moved by a kick raised at the same tick */
+typedef struct round_s{
+  int pair;
+  int round;
+}round_t;
+
+cs_ev_handle_t hs[NPAIRS][NROUNDS];
+int fires[NPAIRS][NROUNDS];
+int moved = 0, missed = 0;
+
+/*
+* Schedule the timer of a round by handle, with target 2*pair (the 
+* mailbox of the task 0), and its kick at the same tick with target 
+* 2*pair+1 (the mailbox of the task 1).
+*/
+void schedule_round(int pair, int round, cs_clockv at, cs_event_manager_t *evm){
+  round_t r = {pair, round};
+  cs_event_t *ev = cs_evm_alloc_event_data(EV_TIMER, &r, sizeof(round_t), evm);
+  ev->target = 2*pair;
+  assert(cs_evm_schedule_event_handle(ev, at, evm, &hs[pair][round])==0);
+  ev = cs_evm_alloc_event_data(EV_KICK, &r, sizeof(round_t), evm);
+  ev->target = 2*pair+1;
+  assert(cs_evm_schedule_event(ev, at, evm)==0);
+}
+
+/* the timer fires once per round, at its time or at the time it is moved to */
+cs_eh_status h_timer(cs_event_t *ev, cs_event_manager_t *evm){
+  round_t r = *((round_t *) ev->ev_data);
+  assert(__sync_add_and_fetch(&fires[r.pair][r.round], 1)==1);
+  if(r.round+1<NROUNDS)
+    schedule_round(r.pair, r.round+1, cs_evm_now(evm)+2, evm);
+  return CS_EH_NORMAL;
+}
+
+/* 
+* Move the timer of the round to the next tick, while the task 0 
+* may be dispatching its schedule for this tick.
+*/
+cs_eh_status h_kick(cs_event_t *ev, cs_event_manager_t *evm){
+  round_t r = *((round_t *) ev->ev_data);
+  if(cs_evm_reschedule(&hs[r.pair][r.round], cs_evm_now(evm)+1, evm)==0)
+    __sync_fetch_and_add(&moved, 1);
+  else
+    __sync_fetch_and_add(&missed, 1);
+  return CS_EH_NORMAL;
+}
+
+int main(int argc, char *argv[]){
+  cs_timer_t *timer;
+  cs_event_manager_t *evm;
+  cs_engine_t *engine;
+  cs_evm_conf_t conf;
+  int p, r;
+
+  log4c_init();
+
+  timer = (cs_timer_t*) calloc(1, sizeof(cs_timer_t));
+  cs_init_timer(timer, "CLOCK_TEST");
+  cs_evm_default_conf(&conf);
+  conf.affinity = 1;
+  evm = (cs_event_manager_t *) malloc(sizeof(cs_event_manager_t));
+  assert(cs_init_event_manager_conf(evm, NTASKS, timer, EVENT_DRIVEN, &conf)==0);
+  assert(cs_evm_install_handler(EV_TIMER, h_timer, evm)==0);
+  assert(cs_evm_install_handler(EV_KICK, h_kick, evm)==0);
+  for(p=0; p<NPAIRS; p++)
+    schedule_round(p, 0, 1, evm);
+
+  engine = (cs_engine_t *) malloc(sizeof(cs_engine_t));
+  cs_init_engine(engine, 2);
+  cs_set_sim_type(engine, EVENT_DRIVEN);
+  cs_set_event_manager(engine, evm);
+  cs_set_timer(engine, timer);
+  cs_sim_start(engine);
+
+  //no timer is lost or recycled while moved, none fires twice
+  for(p=0; p<NPAIRS; p++)
+    for(r=0; r<NROUNDS; r++)
+      assert(fires[p][r]==1);
+  assert(moved+missed==NPAIRS*NROUNDS);
+  assert(cs_evm_num_events(evm)==0);
+
+  log4c_fini();
+  return 0;
+}
@@ -206,7 +206,8 @@ cs_wp_tsk_exit_status simul_travel_task_with_events(cs_data_ptr in, cs_data_ptr
   int i;
   message_t *msg = (message_t *) malloc(sizeof(message_t)*tbag->nmsg);
   int *ret = (int*) malloc(sizeof(int)*tbag->nmsg);
-  cs_event_t *ev = (cs_event_t *) malloc(sizeof(cs_event_t)*tbag->nmsg);
+  message_ev_data_t data;
+  cs_event_t *ev;
 
   /* Initialize messages */
   for(i=0; i<tbag->nmsg; i++){
@@ -215,18 +216,15 @@ cs_wp_tsk_exit_status simul_travel_task_with_events(cs_data_ptr in, cs_data_ptr
     ret[i] = CONTINUE;
   }
 
-  /* initialize events */
+  /* initialize and schedule events, the data is stored in the events */
+  data.sim_data = tbag->sim_data;
   for(i=0; i<tbag->nmsg; i++){
-    ev[i].ev_data = (void*) malloc(sizeof(message_ev_data_t));
-    ((message_ev_data_t *) ev[i].ev_data)->msg = &msg[i];
-    ((message_ev_data_t *) ev[i].ev_data)->sim_data = tbag->sim_data;
-    ev[i].etype = EV_MSG;
+    data.msg = &msg[i];
+    ev = cs_evm_alloc_event_data(EV_MSG, &data, sizeof(message_ev_data_t), tbag->evm);
+    assert(ev!=NULL && CS_EV_DATA_IS_INLINE(ev));
+    assert(cs_evm_schedule_event(ev, (cs_clockv) cs_get_clock(tbag->clock)+1, tbag->evm)==0);
   }
 
-  /* schedule events */
-  for(i=0; i<tbag->nmsg; i++)
-    assert(cs_evm_schedule_event(&ev[i], (cs_clockv) cs_get_clock(tbag->clock)+1, tbag->evm)==0);
-
   return CS_TSK_SUCCESS;
 }
 
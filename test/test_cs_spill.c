@@ -0,0 +1,97 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "complex_sim.h"
+#include "cs_engine.h"
+#include "cs_spill.h"
+
+#define NEVENTS 20000
+#define HORIZON 50
+#define SPAN 5000
+
+#define EV_FAR "FAR"
+
+typedef struct far_s{
+  cs_clockv at; //the time the event is expected at
+  int id;
+}far_t;
+
+long int handled = 0;
+cs_clockv last = -1;
+char seen[NEVENTS];
+
+/*
+* The events come back from the spill file with their payload and target, in time order.
+*/
+cs_eh_status h_far(cs_event_t *ev, cs_event_manager_t *evm){
+  far_t *f = ev->ev_data;
+  cs_clockv now = cs_evm_now(evm);
+
+  assert(CS_EV_DATA_IS_INLINE(ev));
+  assert(f->at==now);
+  assert(ev->target==f->id%7);
+  assert(__sync_fetch_and_add(&seen[f->id], 1)==0);
+  __sync_fetch_and_add(&handled, 1);
+  return CS_EH_NORMAL;
+}
+
+int main(int argc, char *argv[]){
+  cs_timer_t *timer;
+  cs_event_manager_t *evm;
+  cs_engine_t *engine;
+  cs_evm_conf_t conf;
+  cs_event_t *ev;
+  far_t f;
+  cs_clockv farthest = -1;
+  int i;
+
+  log4c_init();
+  srand(1);
+
+  timer = (cs_timer_t*) calloc(1, sizeof(cs_timer_t));
+  cs_init_timer(timer, "CLOCK_TEST");
+
+  evm = (cs_event_manager_t *) malloc(sizeof(cs_event_manager_t));
+  cs_evm_default_conf(&conf);
+  conf.spill_horizon = HORIZON;
+  assert(cs_init_event_manager_conf(evm, 4, timer, EVENT_DRIVEN, &conf)==0);
+  assert(cs_evm_install_handler(EV_FAR, h_far, evm)==0);
+
+  for(i=0; i<NEVENTS; i++){
+    f.at = 1+rand()%SPAN;
+    farthest = MAX(farthest, f.at);
+    f.id = i;
+    ev = cs_evm_alloc_event_data(EV_FAR, &f, sizeof(far_t), evm);
+    CS_EV_SET_TARGET(ev, i%7);
+    assert(cs_evm_schedule_event(ev, f.at, evm)==0);
+  }
+  //the far events are in the file, still counted as pending
+  assert(cs_evm_spilled_events(evm)>NEVENTS/2);
+  assert(cs_evm_num_events(evm)==NEVENTS);
+  assert(cs_evm_find_farthest_events(evm)==farthest);
+
+  engine = (cs_engine_t *) malloc(sizeof(cs_engine_t));
+  cs_init_engine(engine, 2);
+  cs_set_sim_type(engine, EVENT_DRIVEN);
+  cs_set_event_manager(engine, evm);
+  cs_set_timer(engine, timer);
+  cs_sim_start(engine);
+
+  assert(handled==NEVENTS);
+  assert(cs_evm_num_events(evm)==0);
+
+  log4c_fini();
+  return 0;
+}
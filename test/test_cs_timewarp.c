@@ -0,0 +1,172 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "complex_sim.h"
+#include "cs_engine.h"
+#include "cs_timewarp.h"
+
+#define NENTITIES 64
+#define NMSG 1000
+#define TTL 30
+#define WINDOW 10
+
+#define EV_HOP "HOP"
+
+typedef struct hop_s{
+  int id;
+  int hops;
+}hop_t;
+
+/* the state of an entity, saved and restored by the optimistic mode */
+typedef struct entity_s{
+  cs_clockv last;
+  long int count;
+}entity_t;
+
+entity_t entities[NENTITIES];
+int busy[NENTITIES];
+long int saved = 0, restored = 0;
+
+void *save_entity(long int target, void *arg){
+  entity_t *s = malloc(sizeof(entity_t));
+  *s = entities[target];
+  __sync_fetch_and_add(&saved, 1);
+  return s;
+}
+
+void restore_entity(long int target, void *state, void *arg){
+  entities[target] = *((entity_t *) state);
+  __sync_fetch_and_add(&restored, 1);
+}
+
+void discard_entity(long int target, void *state, void *arg){
+  __sync_fetch_and_sub(&saved, 1);
+  free(state);
+}
+
+/*
+* A message hopping between entities: every hop is a new event, since
+* the events handled speculatively must not be modified.
+*/
+cs_eh_status h_hop(cs_event_t *ev, cs_event_manager_t *evm){
+  hop_t h = *((hop_t *) ev->ev_data);
+  long int e = ev->target;
+  cs_clockv now = cs_evm_now(evm);
+  cs_event_t *next;
+
+  assert(__sync_fetch_and_add(&busy[e], 1)==0); //no concurrent events for an entity
+  assert(now>=entities[e].last); //in time order, after the rollbacks
+  entities[e].last = now;
+  entities[e].count++;
+
+  if(++h.hops<TTL){
+    next = cs_evm_alloc_event_data(EV_HOP, &h, sizeof(hop_t), evm);
+    CS_EV_SET_TARGET(next, (e*7+h.hops)%NENTITIES);
+    assert(cs_evm_schedule_event(next, now+1+(h.id+h.hops)%5, evm)==0);
+  }
+  __sync_fetch_and_sub(&busy[e], 1);
+  return CS_EH_NORMAL;
+}
+
+int main(int argc, char *argv[]){
+  cs_timer_t *timer;
+  cs_event_manager_t *evm;
+  cs_engine_t *engine;
+  cs_event_t *ev;
+  cs_tw_stats_t stats;
+  long int total = 0;
+  hop_t h;
+  int i;
+
+  log4c_init();
+  memset(entities, 0, sizeof(entities));
+
+  timer = (cs_timer_t*) calloc(1, sizeof(cs_timer_t));
+  cs_init_timer(timer, "CLOCK_TEST");
+
+  evm = (cs_event_manager_t *) malloc(sizeof(cs_event_manager_t));
+  assert(cs_init_event_manager(evm, 8, timer, EVENT_DRIVEN)==0);
+  assert(cs_evm_timewarp_stats(evm, &stats)<0);
+  assert(cs_evm_enable_timewarp(evm, 0, save_entity, restore_entity, discard_entity, NULL)<0);
+  assert(cs_evm_enable_timewarp(evm, WINDOW, save_entity, restore_entity, discard_entity, NULL)==0);
+  assert(cs_evm_install_handler(EV_HOP, h_hop, evm)==0);
+
+  for(i=0; i<NMSG; i++){
+    h.id = i;
+    h.hops = 0;
+    ev = cs_evm_alloc_event_data(EV_HOP, &h, sizeof(hop_t), evm);
+    CS_EV_SET_TARGET(ev, i%NENTITIES);
+    assert(cs_evm_schedule_event(ev, 1+i%WINDOW, evm)==0);
+  }
+
+  engine = (cs_engine_t *) malloc(sizeof(cs_engine_t));
+  cs_init_engine(engine, 2);
+  cs_set_sim_type(engine, EVENT_DRIVEN);
+  cs_set_event_manager(engine, evm);
+  cs_set_timer(engine, timer);
+  cs_sim_start(engine);
+
+  //every hop committed once, whatever the rollbacks
+  for(i=0; i<NENTITIES; i++)
+    total+=entities[i].count;
+  assert(total==NMSG*TTL);
+  assert(cs_evm_timewarp_stats(evm, &stats)==0);
+  assert(stats.committed==NMSG*TTL);
+  assert(stats.phases>0);
+  assert(saved==0); //every state saved has been released
+
+  /*
+  * A straggler: the entity 1 handles its hop at 8 in the first phase, 
+  * and gets a hop at 2 from the entity 0 (another partition) once the
+  * phase is over. It is rolled back, and the hop it has sent to the 
+  * entity 8 is annihilated.
+  */
+  memset(entities, 0, sizeof(entities));
+  restored = 0;
+  timer = (cs_timer_t*) calloc(1, sizeof(cs_timer_t));
+  cs_init_timer(timer, "CLOCK_TEST");
+  evm = (cs_event_manager_t *) malloc(sizeof(cs_event_manager_t));
+  assert(cs_init_event_manager(evm, 8, timer, EVENT_DRIVEN)==0);
+  assert(cs_evm_enable_timewarp(evm, WINDOW, save_entity, restore_entity, discard_entity, NULL)==0);
+  assert(cs_evm_install_handler(EV_HOP, h_hop, evm)==0);
+  h.id = 0; //to the entity 8 at 10
+  h.hops = 0;
+  ev = cs_evm_alloc_event_data(EV_HOP, &h, sizeof(hop_t), evm);
+  CS_EV_SET_TARGET(ev, 1);
+  assert(cs_evm_schedule_event(ev, 8, evm)==0);
+  h.id = 4; //to the entity 1 at 2
+  ev = cs_evm_alloc_event_data(EV_HOP, &h, sizeof(hop_t), evm);
+  CS_EV_SET_TARGET(ev, 0);
+  assert(cs_evm_schedule_event(ev, 1, evm)==0);
+
+  engine = (cs_engine_t *) malloc(sizeof(cs_engine_t));
+  cs_init_engine(engine, 2);
+  cs_set_sim_type(engine, EVENT_DRIVEN);
+  cs_set_event_manager(engine, evm);
+  cs_set_timer(engine, timer);
+  cs_sim_start(engine);
+
+  for(i=0, total=0; i<NENTITIES; i++)
+    total+=entities[i].count;
+  assert(total==2*TTL);
+  assert(cs_evm_timewarp_stats(evm, &stats)==0);
+  assert(stats.committed==2*TTL);
+  assert(stats.rollbacks>0 && stats.rolled_back>0 && stats.cancelled>0);
+  assert(restored>0 && saved==0);
+
+  log4c_fini();
+  return 0;
+}
@@ -0,0 +1,125 @@
+/* Copyright (c) 2012, Fabrizio Messina, University of Catania
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "complex_sim.h"
+#include "cs_engine.h"
+#include "cs_trace.h"
+
+#define NMSG 2000
+#define TTL 10
+#define TRACE "test_cs_trace.bin"
+
+#define EV_HOP "HOP"
+
+typedef struct hop_s{
+  int id;
+  int hops;
+  cs_clockv at; //the time the event is expected at
+}hop_t;
+
+long int handled = 0, replayed = 0;
+
+cs_eh_status h_hop(cs_event_t *ev, cs_event_manager_t *evm){
+  hop_t h = *((hop_t *) ev->ev_data);
+  cs_event_t *next;
+
+  assert(h.at==cs_evm_now(evm));
+  __sync_fetch_and_add(&handled, 1);
+  if(++h.hops<TTL){
+    h.at+=1+h.id%3;
+    next = cs_evm_alloc_event_data(EV_HOP, &h, sizeof(hop_t), evm);
+    CS_EV_SET_TARGET(next, h.id);
+    assert(cs_evm_schedule_event(next, h.at, evm)==0);
+  }
+  return CS_EH_NORMAL;
+}
+
+/*
+* The replayed events have their time, target and payload; what they 
+* schedule is dropped.
+*/
+cs_eh_status h_replay(cs_event_t *ev, cs_event_manager_t *evm){
+  hop_t *h = (hop_t *) ev->ev_data;
+  assert(h->at==cs_evm_now(evm));
+  assert(ev->target==h->id);
+  replayed++;
+  return h_hop(ev, evm);
+}
+
+cs_eh_status h_replay_batch(cs_event_t **evs, size_t n, cs_event_manager_t *evm){
+  size_t i;
+  for(i=0; i<n; i++)
+    h_replay(evs[i], evm);
+  return CS_EH_NORMAL;
+}
+
+int main(int argc, char *argv[]){
+  cs_timer_t *timer;
+  cs_event_manager_t *evm, *replay;
+  cs_engine_t *engine;
+  cs_event_t *ev;
+  hop_t h;
+  int i;
+
+  log4c_init();
+
+  timer = (cs_timer_t*) calloc(1, sizeof(cs_timer_t));
+  cs_init_timer(timer, "CLOCK_TEST");
+
+  evm = (cs_event_manager_t *) malloc(sizeof(cs_event_manager_t));
+  assert(cs_init_event_manager(evm, 4, timer, EVENT_DRIVEN)==0);
+  assert(cs_evm_install_handler(EV_HOP, h_hop, evm)==0);
+  assert(cs_evm_trace_start(evm, TRACE)==0);
+
+  for(i=0; i<NMSG; i++){
+    h.id = i;
+    h.hops = 0;
+    h.at = 1+i%5;
+    ev = cs_evm_alloc_event_data(EV_HOP, &h, sizeof(hop_t), evm);
+    CS_EV_SET_TARGET(ev, i);
+    assert(cs_evm_schedule_event(ev, h.at, evm)==0);
+  }
+
+  engine = (cs_engine_t *) malloc(sizeof(cs_engine_t));
+  cs_init_engine(engine, 2);
+  cs_set_sim_type(engine, EVENT_DRIVEN);
+  cs_set_event_manager(engine, evm);
+  cs_set_timer(engine, timer);
+  cs_sim_start(engine);
+
+  assert(handled==NMSG*TTL);
+  assert(cs_evm_trace_stop(evm)==NMSG*TTL);
+
+  //replay the trace against another event manager
+  replay = (cs_event_manager_t *) malloc(sizeof(cs_event_manager_t));
+  assert(cs_init_event_manager(replay, 1, timer, EVENT_DRIVEN)==0);
+  assert(cs_evm_install_handler(EV_HOP, h_replay, replay)==0);
+  assert(cs_evm_trace_replay(replay, TRACE)==NMSG*TTL);
+  assert(replayed==NMSG*TTL);
+  assert(cs_evm_num_events(replay)==0);
+  cs_destroy_event_manager(replay);
+
+  //the events of a type with a batch handler only
+  assert(cs_init_event_manager(replay, 1, timer, EVENT_DRIVEN)==0);
+  assert(cs_evm_install_batch_handler(EV_HOP, h_replay_batch, replay)==0);
+  assert(cs_evm_trace_replay(replay, TRACE)==NMSG*TTL);
+  assert(replayed==2*NMSG*TTL);
+  cs_destroy_event_manager(replay);
+  remove(TRACE);
+
+  log4c_fini();
+  return 0;
+}
@@ -38,6 +38,10 @@ int main(int argc, char *argv[]){
 	if(cs_wp_init(10, 10, wp, "TEST-WP")<0 || cs_wp_start(wp)<0)
 	    log4c_category_log(log, LOG4C_PRIORITY_ERROR, " Unable to init the worker pool ");
 
+	cs_queue_stats_t qstats;
+	assert(cs_wp_tsk_queue_stats(wp, &qstats)<0); //not enabled yet
+	assert(cs_wp_tsk_queue_enable_stats(wp, 1)==0);
+
 	int *s1 = (int *) malloc(sizeof(int));
 	*s1 = SL;
 
@@ -71,6 +75,14 @@ int main(int argc, char *argv[]){
 	assert((res2 = cs_wp_tsk_get_res(wp, myid2))!=NULL);
 	assert((res2 = cs_wp_tsk_pop_res(wp, myid2))!=NULL);
 
+	//check the counters of the task queue
+	assert(cs_wp_tsk_queue_stats(wp, &qstats)==0);
+	assert(qstats.enqueues==2 && qstats.dequeues==2);
+	assert(qstats.depth==0 && qstats.max_depth>=1 && qstats.max_depth<=2);
+	assert(qstats.residence.samples==2);
+	log4c_category_log(log, LOG4C_PRIORITY_NOTICE, "Task queue: max depth %d, p99 residence < %llu ns",\
+	 qstats.max_depth, cs_log_hist_percentile(&qstats.residence, 99));
+
 	assert(res1->tsk_exit_code==CS_TSK_SUCCESS);
 	log4c_category_log(log, LOG4C_PRIORITY_NOTICE, "Result 1: %d ",  *((int*) res1->tsk_res_data));
 